@@ -67,6 +67,11 @@ TARGET_SCREEN_DENSITY := 480
 # Filesystem
 TARGET_FS_CONFIG_GEN := $(DEVICE_PATH)/configs/config.fs
 
+# Fingerprint
+SOONG_CONFIG_NAMESPACES += PERIDOT_FINGERPRINT
+SOONG_CONFIG_PERIDOT_FINGERPRINT := sensor_type
+SOONG_CONFIG_PERIDOT_FINGERPRINT_sensor_type := udfps
+
 # Hardware
 BOARD_USES_QCOM_HARDWARE := true
 
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "CallbackAggregator.h"
+
+#include <android-base/stringprintf.h>
+
+#include "util/Util.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+bool CallbackAggregator::addRemoved(int32_t fid, uint32_t remaining, std::vector<int32_t>* out) {
+    std::lock_guard<std::mutex> lock(mLock);
+    return addLocked(&mRemoved, fid, remaining, out);
+}
+
+bool CallbackAggregator::addEnumerated(int32_t fid, uint32_t remaining,
+                                       std::vector<int32_t>* out) {
+    std::lock_guard<std::mutex> lock(mLock);
+    return addLocked(&mEnumerated, fid, remaining, out);
+}
+
+bool CallbackAggregator::addLocked(std::vector<int32_t>* pending, int32_t fid,
+                                   uint32_t remaining, std::vector<int32_t>* out) {
+    mMessages++;
+    if (fid != 0) {
+        pending->push_back(fid);
+    }
+    if (remaining != 0) {
+        return false;
+    }
+    out->swap(*pending);
+    pending->clear();
+    mCallbacks++;
+    return true;
+}
+
+bool CallbackAggregator::isDuplicateAcquired(int32_t info, int32_t vendorCode) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mMessages++;
+    int64_t now = Util::getSystemNanoTime();
+    bool duplicate = info == mLastInfo && vendorCode == mLastVendorCode &&
+                     now - mLastAcquiredNs < kAcquiredWindowMs * 1000000LL;
+    mLastInfo = info;
+    mLastVendorCode = vendorCode;
+    if (duplicate) {
+        mDuplicateAcquired++;
+        return true;
+    }
+    // The window runs from the last message that went out, so a steady stream still gets
+    // through at the window's rate.
+    mLastAcquiredNs = now;
+    mCallbacks++;
+    return false;
+}
+
+void CallbackAggregator::endAcquired() {
+    std::lock_guard<std::mutex> lock(mLock);
+    mLastInfo = -1;
+}
+
+bool CallbackAggregator::abort(std::vector<int32_t>* out) {
+    std::lock_guard<std::mutex> lock(mLock);
+    bool removed = !mRemoved.empty();
+    if (removed || !mEnumerated.empty()) mAborted++;
+    if (removed) {
+        out->swap(mRemoved);
+        mRemoved.clear();
+    }
+    mEnumerated.clear();
+    mLastInfo = -1;
+    return removed;
+}
+
+void CallbackAggregator::reset() {
+    std::lock_guard<std::mutex> lock(mLock);
+    mRemoved.clear();
+    mEnumerated.clear();
+    mLastInfo = -1;
+}
+
+std::string CallbackAggregator::toString() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return ::android::base::StringPrintf(
+            "callbacks: messages=%llu sent=%llu duplicateAcquired=%llu aborted=%llu "
+            "pending removed=%zu enumerated=%zu\n",
+            static_cast<unsigned long long>(mMessages), static_cast<unsigned long long>(mCallbacks),
+            static_cast<unsigned long long>(mDuplicateAcquired),
+            static_cast<unsigned long long>(mAborted), mRemoved.size(), mEnumerated.size());
+}
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_TAG "FingerprintHalCallback"
+
+#include "CallbackDispatcher.h"
+
+#include <aidl/android/hardware/biometrics/fingerprint/BnSessionCallback.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+
+#include <pthread.h>
+
+#include <algorithm>
+
+#include "FingerprintTrace.h"
+#include "util/Util.h"
+
+using ::android::base::StringAppendF;
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+namespace {
+
+using Method = CallbackDispatcher::Method;
+
+constexpr const char* kMethodNames[] = {
+        "onChallengeGenerated",       "onChallengeRevoked",
+        "onAcquired",                 "onError",
+        "onEnrollmentProgress",       "onAuthenticationSucceeded",
+        "onAuthenticationFailed",     "onLockoutTimed",
+        "onLockoutPermanent",         "onLockoutCleared",
+        "onInteractionDetected",      "onEnrollmentsEnumerated",
+        "onEnrollmentsRemoved",       "onAuthenticatorIdRetrieved",
+        "onAuthenticatorIdInvalidated", "onSessionClosed",
+};
+static_assert(std::size(kMethodNames) == static_cast<size_t>(Method::kCount));
+
+// Stands in for the framework's callback: every call is queued on the dispatcher.
+class AsyncSessionCallback : public BnSessionCallback {
+  public:
+    AsyncSessionCallback(CallbackDispatcher* dispatcher, std::shared_ptr<ISessionCallback> target)
+        : mDispatcher(dispatcher), mTarget(std::move(target)) {}
+
+    ndk::ScopedAStatus onChallengeGenerated(int64_t challenge) override {
+        return post(Method::kChallengeGenerated, challenge);
+    }
+    ndk::ScopedAStatus onChallengeRevoked(int64_t challenge) override {
+        return post(Method::kChallengeRevoked, challenge);
+    }
+    ndk::ScopedAStatus onAcquired(AcquiredInfo info, int32_t vendorCode) override {
+        return post(Method::kAcquired, static_cast<int64_t>(info), vendorCode);
+    }
+    ndk::ScopedAStatus onError(Error error, int32_t vendorCode) override {
+        return post(Method::kError, static_cast<int64_t>(error), vendorCode);
+    }
+    ndk::ScopedAStatus onEnrollmentProgress(int32_t enrollmentId, int32_t remaining) override {
+        return post(Method::kEnrollmentProgress, enrollmentId, remaining);
+    }
+    ndk::ScopedAStatus onAuthenticationSucceeded(
+            int32_t enrollmentId, const keymaster::HardwareAuthToken& hat) override {
+        mDispatcher->postAuthenticated(mTarget, enrollmentId, hat);
+        return ndk::ScopedAStatus::ok();
+    }
+    ndk::ScopedAStatus onAuthenticationFailed() override {
+        return post(Method::kAuthenticationFailed);
+    }
+    ndk::ScopedAStatus onLockoutTimed(int64_t durationMillis) override {
+        return post(Method::kLockoutTimed, durationMillis);
+    }
+    ndk::ScopedAStatus onLockoutPermanent() override { return post(Method::kLockoutPermanent); }
+    ndk::ScopedAStatus onLockoutCleared() override { return post(Method::kLockoutCleared); }
+    ndk::ScopedAStatus onInteractionDetected() override {
+        return post(Method::kInteractionDetected);
+    }
+    ndk::ScopedAStatus onEnrollmentsEnumerated(const std::vector<int32_t>& ids) override {
+        mDispatcher->postEnrollments(mTarget, Method::kEnrollmentsEnumerated, ids);
+        return ndk::ScopedAStatus::ok();
+    }
+    ndk::ScopedAStatus onEnrollmentsRemoved(const std::vector<int32_t>& ids) override {
+        mDispatcher->postEnrollments(mTarget, Method::kEnrollmentsRemoved, ids);
+        return ndk::ScopedAStatus::ok();
+    }
+    ndk::ScopedAStatus onAuthenticatorIdRetrieved(int64_t id) override {
+        return post(Method::kAuthenticatorIdRetrieved, id);
+    }
+    ndk::ScopedAStatus onAuthenticatorIdInvalidated(int64_t id) override {
+        return post(Method::kAuthenticatorIdInvalidated, id);
+    }
+    ndk::ScopedAStatus onSessionClosed() override { return post(Method::kSessionClosed); }
+
+  private:
+    ndk::ScopedAStatus post(Method method, int64_t value = 0, int32_t code = 0) {
+        mDispatcher->post(mTarget, method, value, code);
+        return ndk::ScopedAStatus::ok();
+    }
+
+    CallbackDispatcher* const mDispatcher;
+    const std::shared_ptr<ISessionCallback> mTarget;
+};
+
+}  // namespace
+
+CallbackDispatcher::CallbackDispatcher()
+    : mSlots(kInitialSlots),
+      mHead(0),
+      mSize(0),
+      mIsDestructing(false),
+      mMaxDepth(0),
+      mGrown(0),
+      mFailed(0),
+      mSlow(0),
+      mThread([this] { threadFunc(); }) {}
+
+CallbackDispatcher::~CallbackDispatcher() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mIsDestructing = true;
+    }
+    mCond.notify_all();
+    mThread.join();
+}
+
+std::shared_ptr<ISessionCallback> CallbackDispatcher::wrap(
+        std::shared_ptr<ISessionCallback> target) {
+    return ndk::SharedRefBase::make<AsyncSessionCallback>(this, std::move(target));
+}
+
+CallbackDispatcher::Call& CallbackDispatcher::pushLocked(
+        const std::shared_ptr<ISessionCallback>& target, Method method) {
+    if (mSize == mSlots.size()) {
+        // Unroll the ring into a larger one, the slots keep their buffers.
+        std::vector<Call> slots(mSlots.size() * 2);
+        for (size_t i = 0; i < mSize; i++) {
+            slots[i] = std::move(mSlots[(mHead + i) % mSlots.size()]);
+        }
+        mSlots.swap(slots);
+        mHead = 0;
+        mGrown++;
+    }
+    Call& call = mSlots[(mHead + mSize) % mSlots.size()];
+    mSize++;
+    mMaxDepth = std::max(mMaxDepth, mSize);
+    call.target = target;
+    call.method = method;
+    call.enqueueTime = Util::getSystemNanoTime();
+    call.value = 0;
+    call.code = 0;
+    return call;
+}
+
+void CallbackDispatcher::post(const std::shared_ptr<ISessionCallback>& target, Method method,
+                              int64_t value, int32_t code) {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        Call& call = pushLocked(target, method);
+        call.value = value;
+        call.code = code;
+    }
+    mCond.notify_one();
+}
+
+void CallbackDispatcher::postAuthenticated(const std::shared_ptr<ISessionCallback>& target,
+                                           int32_t enrollmentId,
+                                           const keymaster::HardwareAuthToken& hat) {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        Call& call = pushLocked(target, Method::kAuthenticationSucceeded);
+        call.value = enrollmentId;
+        call.hat = hat;
+    }
+    mCond.notify_one();
+}
+
+void CallbackDispatcher::postEnrollments(const std::shared_ptr<ISessionCallback>& target,
+                                         Method method, const std::vector<int32_t>& ids) {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        Call& call = pushLocked(target, method);
+        call.ids = ids;
+    }
+    mCond.notify_one();
+}
+
+ndk::ScopedAStatus CallbackDispatcher::deliver(const Call& call) {
+    ISessionCallback* cb = call.target.get();
+    switch (call.method) {
+        case Method::kChallengeGenerated:
+            return cb->onChallengeGenerated(call.value);
+        case Method::kChallengeRevoked:
+            return cb->onChallengeRevoked(call.value);
+        case Method::kAcquired:
+            return cb->onAcquired(static_cast<AcquiredInfo>(call.value), call.code);
+        case Method::kError:
+            return cb->onError(static_cast<Error>(call.value), call.code);
+        case Method::kEnrollmentProgress:
+            return cb->onEnrollmentProgress(static_cast<int32_t>(call.value), call.code);
+        case Method::kAuthenticationSucceeded:
+            return cb->onAuthenticationSucceeded(static_cast<int32_t>(call.value), call.hat);
+        case Method::kAuthenticationFailed:
+            return cb->onAuthenticationFailed();
+        case Method::kLockoutTimed:
+            return cb->onLockoutTimed(call.value);
+        case Method::kLockoutPermanent:
+            return cb->onLockoutPermanent();
+        case Method::kLockoutCleared:
+            return cb->onLockoutCleared();
+        case Method::kInteractionDetected:
+            return cb->onInteractionDetected();
+        case Method::kEnrollmentsEnumerated:
+            return cb->onEnrollmentsEnumerated(call.ids);
+        case Method::kEnrollmentsRemoved:
+            return cb->onEnrollmentsRemoved(call.ids);
+        case Method::kAuthenticatorIdRetrieved:
+            return cb->onAuthenticatorIdRetrieved(call.value);
+        case Method::kAuthenticatorIdInvalidated:
+            return cb->onAuthenticatorIdInvalidated(call.value);
+        case Method::kSessionClosed:
+            return cb->onSessionClosed();
+        case Method::kCount:
+            break;
+    }
+    return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+}
+
+void CallbackDispatcher::threadFunc() {
+    // Shows up in traces, and tells the thread apart in tests.
+    pthread_setname_np(pthread_self(), "FpCallback");
+    std::unique_lock<std::mutex> lock(mLock);
+    while (true) {
+        mCond.wait(lock, [this] { return mIsDestructing || mSize != 0; });
+        if (mSize == 0) {
+            return;
+        }
+        // The emptied mCurrent goes back into the ring, so buffers just move between slots.
+        std::swap(mCurrent, mSlots[mHead]);
+        mHead = (mHead + 1) % mSlots.size();
+        mSize--;
+        lock.unlock();
+
+        size_t index = static_cast<size_t>(mCurrent.method);
+        int64_t start = Util::getSystemNanoTime();
+        mQueueTime.record(start - mCurrent.enqueueTime);
+        ndk::ScopedAStatus status = [&] {
+            FP_TRACE_NAME(kMethodNames[index]);
+            return deliver(mCurrent);
+        }();
+        int64_t durationNs = Util::getSystemNanoTime() - start;
+        mCallTime[index].record(durationNs);
+        // Don't keep a closed session's callback alive from an idle slot.
+        mCurrent.target.reset();
+
+        lock.lock();
+        if (!status.isOk()) {
+            mFailed++;
+            LOG(ERROR) << kMethodNames[index] << " failed: " << status.getDescription();
+        }
+        if (durationNs > kSlowCallMs * 1000000LL) {
+            mSlow++;
+            LOG(WARNING) << kMethodNames[index] << " took " << durationNs / 1000000.0 << "ms";
+        }
+    }
+}
+
+std::string CallbackDispatcher::toString() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    std::string out = ::android::base::StringPrintf(
+            "callback dispatcher: pending=%zu maxDepth=%zu slots=%zu grown=%llu failed=%llu "
+            "slow=%llu\n  queue %s\n",
+            mSize, mMaxDepth, mSlots.size(), static_cast<unsigned long long>(mGrown),
+            static_cast<unsigned long long>(mFailed),
+            static_cast<unsigned long long>(mSlow), mQueueTime.toString().c_str());
+    for (size_t i = 0; i < kMethodCount; i++) {
+        if (mCallTime[i].count() == 0) continue;
+        StringAppendF(&out, "  %-28s %s\n", kMethodNames[i], mCallTime[i].toString().c_str());
+    }
+    return out;
+}
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
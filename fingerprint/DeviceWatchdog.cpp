@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_TAG "FingerprintHalWatchdog"
+
+#include "DeviceWatchdog.h"
+
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+
+#include <chrono>
+
+#include "FingerprintTrace.h"
+#include "util/Util.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+DeviceWatchdog::Scope::Scope(DeviceWatchdog* watchdog, const char* call, int64_t timeoutMs)
+    : mWatchdog(watchdog), mSeq(watchdog->enter(call, timeoutMs)) {}
+
+DeviceWatchdog::Scope::~Scope() {
+    mWatchdog->leave(mSeq);
+}
+
+bool DeviceWatchdog::Scope::abandoned() const {
+    std::lock_guard<std::mutex> lock(mWatchdog->mLock);
+    // Calls are made one at a time, so anything up to the last abandoned call that is still
+    // around was given up on.
+    return mSeq <= mWatchdog->mAbandonedSeq;
+}
+
+DeviceWatchdog::DeviceWatchdog(HangHandler onHang)
+    : mOnHang(std::move(onHang)),
+      mCall(nullptr),
+      mStartNs(0),
+      mDeadlineNs(0),
+      mSeq(0),
+      mAbandonedSeq(0),
+      mIdle(false),
+      mIsDestructing(false),
+      mCalls(0),
+      mHangs(0),
+      mLastHang(nullptr),
+      mThread([this] { threadFunc(); }) {}
+
+DeviceWatchdog::~DeviceWatchdog() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mIsDestructing = true;
+    }
+    mCond.notify_all();
+    mThread.join();
+}
+
+uint64_t DeviceWatchdog::enter(const char* call, int64_t timeoutMs) {
+    bool wake;
+    uint64_t seq;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        seq = ++mSeq;
+        mCalls++;
+        mStartNs = Util::getSystemNanoTime();
+        if (timeoutMs <= 0) {
+            mCall = nullptr;
+            return seq;
+        }
+        mCall = call;
+        mCaller = std::this_thread::get_id();
+        mDeadlineNs = mStartNs + timeoutMs * 1000000;
+        wake = mIdle;
+    }
+    if (wake) mCond.notify_one();
+    return seq;
+}
+
+void DeviceWatchdog::leave(uint64_t seq) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (seq != mSeq) {
+        return;
+    }
+    mCallTime.record(Util::getSystemNanoTime() - mStartNs);
+    mCall = nullptr;
+}
+
+void DeviceWatchdog::threadFunc() {
+    std::unique_lock<std::mutex> lock(mLock);
+    while (!mIsDestructing) {
+        if (mCall == nullptr) {
+            mIdle = true;
+            mCond.wait(lock, [this] { return mIsDestructing || mCall != nullptr; });
+            mIdle = false;
+            continue;
+        }
+        int64_t now = Util::getSystemNanoTime();
+        if (now < mDeadlineNs) {
+            // Woken early only on destruction, a new call after this one keeps us sleeping
+            // until its own deadline on the next round.
+            mCond.wait_for(lock, std::chrono::nanoseconds(mDeadlineNs - now));
+            continue;
+        }
+
+        const char* call = mCall;
+        std::thread::id caller = mCaller;
+        int64_t startNs = mStartNs;
+        mAbandonedSeq = mSeq;
+        mCall = nullptr;
+        mHangs++;
+        mLastHang = call;
+        LOG(ERROR) << call << " did not return within "
+                   << (now - startNs) / 1000000 << "ms, giving up on it";
+        ATRACE_INSTANT("FpDeviceHang");
+        lock.unlock();
+        mOnHang(call, startNs, caller);
+        lock.lock();
+    }
+}
+
+std::string DeviceWatchdog::toString() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return ::android::base::StringPrintf(
+            "watchdog: calls=%llu hangs=%llu lastHang=%s inFlight=%s\n  call %s\n",
+            static_cast<unsigned long long>(mCalls), static_cast<unsigned long long>(mHangs),
+            mLastHang ? mLastHang : "-", mCall ? mCall : "-", mCallTime.toString().c_str());
+}
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
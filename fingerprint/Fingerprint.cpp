@@ -15,6 +15,11 @@
  */
 
 #include "Fingerprint.h"
+#ifndef FINGERPRINT_ENGINE_FIXED
+#include "FingerprintEngineRear.h"
+#include "FingerprintEngineSide.h"
+#endif
+#include "FingerprintTrace.h"
 #include "Session.h"
 
 #include <android-base/properties.h>
@@ -24,11 +29,18 @@
 #include <android-base/logging.h>
 #include <android-base/stringprintf.h>
 
+#include <algorithm>
+
+#include <unistd.h>
+
+#include "util/Util.h"
+
 using namespace ::android::fingerprint::peridot;
 
 namespace aidl::android::hardware::biometrics::fingerprint {
 namespace {
 constexpr size_t MAX_WORKER_QUEUE_SIZE = 5;
+constexpr size_t MAX_POOLED_SESSIONS = 4;
 constexpr int SENSOR_ID = 5;
 constexpr common::SensorStrength SENSOR_STRENGTH = common::SensorStrength::STRONG;
 constexpr int MAX_ENROLLMENTS_PER_USER = 5;
@@ -44,10 +56,21 @@ constexpr char SW_VERSION[] = "vendor/version/revision";
 
 static Fingerprint* sInstance;
 
-Fingerprint::Fingerprint() : mWorker(MAX_WORKER_QUEUE_SIZE) {
+Fingerprint::Fingerprint()
+    : mWorker(MAX_WORKER_QUEUE_SIZE),
+      mNotifyDispatcher([this](const fingerprint_msg_t& msg) { dispatchNotify(msg); }) {
     sInstance = this;  // keep track of the most recent instance
+    int64_t start = Util::getSystemNanoTime();
 
-    std::string sensorTypeProp = Fingerprint::cfg().get<std::string>("type");
+#ifdef FINGERPRINT_ENGINE_FIXED
+    std::string sensorTypeProp = kFixedSensorType;
+    if (Fingerprint::cfg().snapshot().type != sensorTypeProp) {
+        LOG(WARNING) << "Built for " << sensorTypeProp << " sensors, ignoring type "
+                     << Fingerprint::cfg().snapshot().type;
+    }
+#else
+    std::string sensorTypeProp = Fingerprint::cfg().snapshot().type;
+#endif
     if (sensorTypeProp == "" || sensorTypeProp == "default" || sensorTypeProp == "rear") {
         mSensorType = FingerprintSensorType::REAR;
     } else if (sensorTypeProp == "udfps") {
@@ -61,18 +84,70 @@ Fingerprint::Fingerprint() : mWorker(MAX_WORKER_QUEUE_SIZE) {
         UNIMPLEMENTED(FATAL) << "unrecognized or unimplemented fingerprint behavior: "
                              << sensorTypeProp;
     }
-    mEngine = std::make_unique<FingerprintEngine>();
+#ifdef FINGERPRINT_ENGINE_FIXED
+    mEngine = std::make_unique<Engine>();
+#else
+    switch (mSensorType) {
+        case FingerprintSensorType::REAR:
+            mEngine = std::make_unique<FingerprintEngineRear>();
+            break;
+        case FingerprintSensorType::POWER_BUTTON:
+            mEngine = std::make_unique<FingerprintEngineSide>();
+            break;
+        default:
+            mEngine = std::make_unique<FingerprintEngine>();
+            break;
+    }
+#endif
+    mEngine->attach(&mWorker, &mTimers);
+    mEngine->onStarted(Util::getSystemNanoTime() - start);
     LOG(INFO) << "sensorTypeProp:" << sensorTypeProp;
     LOG(INFO) << "ro.product.name=" << ::android::base::GetProperty("ro.product.name", "UNKNOWN");
 }
 
-void Fingerprint::notify(const fingerprint_msg_t* msg) {
+fingerprint_notify_t Fingerprint::nextNotify() {
+    static constexpr auto kNotify = notifyTable(
+            std::make_integer_sequence<uint32_t, NotifyDispatcher::kGenerations>());
+    Fingerprint* thisPtr = sInstance;
+    CHECK(thisPtr) << "Opening the vendor device before the HAL is initialized";
+    return kNotify[thisPtr->mNotifyDispatcher.nextGeneration()];
+}
+
+// Runs on the vendor callback thread: copy the message and return without touching binder.
+void Fingerprint::notify(const fingerprint_msg_t* msg, uint32_t generation) {
+    ATRACE_INSTANT(traceName(msg->type));
     Fingerprint* thisPtr = sInstance;
-    if (thisPtr == nullptr || thisPtr->mSession == nullptr || thisPtr->mSession->isClosed()) {
+    if (thisPtr == nullptr) {
+        LOG(ERROR) << "Receiving callbacks before the HAL is initialized.";
+        return;
+    }
+    thisPtr->mNotifyDispatcher.post(msg, generation);
+}
+
+void Fingerprint::inject(const fingerprint_msg_t& msg) {
+    Fingerprint* thisPtr = sInstance;
+    if (thisPtr == nullptr) {
+        return;
+    }
+    thisPtr->mNotifyDispatcher.inject(msg);
+}
+
+// Runs on the notify dispatcher thread.
+void Fingerprint::dispatchNotify(const fingerprint_msg_t& msg) {
+    FP_TRACE_CALL();
+    if (mEngine->interceptNotify(msg)) {
+        return;
+    }
+    std::shared_ptr<Session> session;
+    {
+        std::lock_guard<std::mutex> lock(mSessionLock);
+        session = mSession;
+    }
+    if (session == nullptr || session->isClosed()) {
         LOG(ERROR) << "Receiving callbacks before a session is opened.";
         return;
     }
-    thisPtr->mSession->notify(msg);
+    session->notify(&msg);
 }
 
 ndk::ScopedAStatus Fingerprint::getSensorProps(std::vector<SensorProps>* out) {
@@ -80,14 +155,10 @@ ndk::ScopedAStatus Fingerprint::getSensorProps(std::vector<SensorProps>* out) {
             {HW_COMPONENT_ID, HW_VERSION, FW_VERSION, SERIAL_NUMBER, "" /* softwareVersion */},
             {SW_COMPONENT_ID, "" /* hardwareVersion */, "" /* firmwareVersion */,
              "" /* serialNumber */, SW_VERSION}};
-    auto sensorId = Fingerprint::cfg().get<std::int32_t>("sensor_id");
-    auto sensorStrength = Fingerprint::cfg().get<std::int32_t>("sensor_strength");
-    auto navigationGuesture = Fingerprint::cfg().get<bool>("navigation_guesture");
-    auto detectInteraction = Fingerprint::cfg().get<bool>("detect_interaction");
-    auto displayTouch = Fingerprint::cfg().get<bool>("display_touch");
-    auto controlIllumination = Fingerprint::cfg().get<bool>("control_illumination");
-
-    common::CommonProps commonProps = {sensorId, (common::SensorStrength)sensorStrength,
+    const auto& config = Fingerprint::cfg().snapshot();
+
+    common::CommonProps commonProps = {config.sensorId,
+                                       (common::SensorStrength)config.sensorStrength,
                                        MAX_ENROLLMENTS_PER_USER, componentInfo};
 
     SensorLocation sensorLocation = mEngine->getSensorLocation();
@@ -98,10 +169,10 @@ ndk::ScopedAStatus Fingerprint::getSensorProps(std::vector<SensorProps>* out) {
     *out = {{commonProps,
              mSensorType,
              {sensorLocation},
-             navigationGuesture,
-             detectInteraction,
-             displayTouch,
-             controlIllumination,
+             config.navigationGuesture,
+             config.detectInteraction,
+             config.displayTouch,
+             config.controlIllumination,
              std::nullopt}};
     return ndk::ScopedAStatus::ok();
 }
@@ -109,15 +180,61 @@ ndk::ScopedAStatus Fingerprint::getSensorProps(std::vector<SensorProps>* out) {
 ndk::ScopedAStatus Fingerprint::createSession(int32_t sensorId, int32_t userId,
                                               const std::shared_ptr<ISessionCallback>& cb,
                                               std::shared_ptr<ISession>* out) {
+    int64_t start = Util::getSystemNanoTime();
+    std::lock_guard<std::mutex> lock(mSessionLock);
     CHECK(mSession == nullptr || mSession->isClosed()) << "Open session already exists!";
 
-    mSession = SharedRefBase::make<Session>(sensorId, userId, cb, mEngine.get(), &mWorker);
+    auto pooled = std::find_if(mSessionPool.begin(), mSessionPool.end(), [&](const auto& session) {
+        return session->getSensorId() == sensorId && session->getUserId() == userId;
+    });
+    bool reused = pooled != mSessionPool.end();
+    if (reused) {
+        mSession = *pooled;
+        mSessionPool.erase(pooled);
+        mSession->reopen(cb);
+    } else {
+        mSession = SharedRefBase::make<Session>(sensorId, userId, cb, mEngine.get(), &mWorker);
+        if (mSessionPool.size() >= MAX_POOLED_SESSIONS) mSessionPool.pop_back();
+    }
+    mSessionPool.push_front(mSession);
     *out = mSession;
 
     mSession->linkToDeath(cb->asBinder().get());
 
-    LOG(INFO) << __func__ << ": sensorId:" << sensorId << " userId:" << userId;
+    int64_t elapsed = Util::getSystemNanoTime() - start;
+    mSessionSwitchTime[reused ? 1 : 0].record(elapsed);
+    LOG(INFO) << __func__ << ": sensorId:" << sensorId << " userId:" << userId
+              << (reused ? " (reused)" : "") << " in " << elapsed / 1000000.0 << "ms";
     return ndk::ScopedAStatus::ok();
 }
 
+binder_status_t Fingerprint::dump(int fd, const char** /*args*/, uint32_t /*numArgs*/) {
+    if (fd < 0) {
+        LOG(ERROR) << __func__ << ": invalid fd " << fd;
+        return STATUS_BAD_VALUE;
+    }
+
+    std::string out = "----- FingerprintHal::dump -----\n";
+    ::android::base::StringAppendF(&out, "sensorType: %s\n",
+                                   ::android::internal::ToString(mSensorType).c_str());
+    out += mEngine->toString();
+    out += mEngine->mMetrics.toString();
+    {
+        std::lock_guard<std::mutex> lock(mSessionLock);
+        ::android::base::StringAppendF(&out, "----- Sessions -----\npooled=%zu\n",
+                                       mSessionPool.size());
+        ::android::base::StringAppendF(&out, "new switch %s\n",
+                                       mSessionSwitchTime[0].toString().c_str());
+        ::android::base::StringAppendF(&out, "reused switch %s\n",
+                                       mSessionSwitchTime[1].toString().c_str());
+        if (mSession) out += mSession->toString();
+    }
+    out += mWorker.toString();
+    out += mTimers.toString();
+    out += mNotifyDispatcher.toString();
+    ::android::base::WriteStringToFd(out, fd);
+    fsync(fd);
+    return STATUS_OK;
+}
+
 }  // namespace aidl::android::hardware::biometrics::fingerprint
@@ -19,10 +19,15 @@
 #include "FingerprintConfig.h"
 
 #include <android-base/logging.h>
+#include <android-base/parseint.h>
 
 #include <fingerprint.sysprop.h>
+#include <sys/system_properties.h>
+
+#include "util/Util.h"
 
 using namespace ::android::fingerprint::peridot;
+using ::android::base::ParseInt;
 
 namespace aidl::android::hardware::biometrics::fingerprint {
 
@@ -43,6 +48,18 @@ CREATE_GETTER_SETTER_WRAPPER(navigation_guesture, OptBool)
 CREATE_GETTER_SETTER_WRAPPER(detect_interaction, OptBool)
 CREATE_GETTER_SETTER_WRAPPER(display_touch, OptBool)
 CREATE_GETTER_SETTER_WRAPPER(control_illumination, OptBool)
+CREATE_GETTER_SETTER_WRAPPER(touch_input, OptBool)
+CREATE_GETTER_SETTER_WRAPPER(touch_device, OptString)
+CREATE_GETTER_SETTER_WRAPPER(press_notify, OptBool)
+CREATE_GETTER_SETTER_WRAPPER(power_key_device, OptString)
+CREATE_GETTER_SETTER_WRAPPER(touch_margin, OptInt32)
+CREATE_GETTER_SETTER_WRAPPER(display_scale_percent, OptInt32)
+CREATE_GETTER_SETTER_WRAPPER(palm_size, OptInt32)
+CREATE_GETTER_SETTER_WRAPPER(authenticate_timeout_ms, OptInt32)
+CREATE_GETTER_SETTER_WRAPPER(binder_threads, OptInt32)
+CREATE_GETTER_SETTER_WRAPPER(boost_uclamp_min, OptInt32)
+CREATE_GETTER_SETTER_WRAPPER(boost_cpus, OptString)
+CREATE_GETTER_SETTER_WRAPPER(watchdog_ms, OptInt32)
 
 // Name, Getter, Setter, Parser and default value
 #define NGS(_NAME_) #_NAME_, _NAME_##Getter, _NAME_##Setter
@@ -55,6 +72,18 @@ static Config::Data configData[] = {
         {NGS(detect_interaction), &Config::parseBool, "false"},
         {NGS(display_touch), &Config::parseBool, "true"},
         {NGS(control_illumination), &Config::parseBool, "false"},
+        {NGS(touch_input), &Config::parseBool, "false"},
+        {NGS(touch_device), &Config::parseString, "/dev/input/event2"},
+        {NGS(press_notify), &Config::parseBool, "false"},
+        {NGS(power_key_device), &Config::parseString, ""},
+        {NGS(touch_margin), &Config::parseInt32, "100"},
+        {NGS(display_scale_percent), &Config::parseInt32, "100"},
+        {NGS(palm_size), &Config::parseInt32, "0"},
+        {NGS(authenticate_timeout_ms), &Config::parseInt32, "0"},
+        {NGS(binder_threads), &Config::parseInt32, "0"},
+        {NGS(boost_uclamp_min), &Config::parseInt32, "0"},
+        {NGS(boost_cpus), &Config::parseString, ""},
+        {NGS(watchdog_ms), &Config::parseInt32, "2000"},
 };
 
 Config::Data* FingerprintConfig::getConfigData(int* size) {
@@ -62,4 +91,112 @@ Config::Data* FingerprintConfig::getConfigData(int* size) {
     return configData;
 }
 
+const std::array<const char*, FingerprintConfig::kPropertyCount> FingerprintConfig::kPropertyNames =
+        {
+                "persist.vendor.fingerprint.type",
+                "persist.vendor.fingerprint.sensor_id",
+                "persist.vendor.fingerprint.sensor_location",
+                "persist.vendor.fingerprint.sensor_strength",
+                "persist.vendor.fingerprint.navigation_guesture",
+                "persist.vendor.fingerprint.detect_interaction",
+                "persist.vendor.fingerprint.udfps.display_touch",
+                "persist.vendor.fingerprint.udfps.control_illumination",
+                "persist.vendor.fingerprint.udfps.touch_input",
+                "persist.vendor.fingerprint.udfps.touch_device",
+                "persist.vendor.fingerprint.udfps.press_notify",
+                "persist.vendor.fingerprint.side.power_key_device",
+                "persist.vendor.fingerprint.udfps.touch_margin",
+                "persist.vendor.fingerprint.udfps.display_scale_percent",
+                "persist.vendor.fingerprint.udfps.palm_size",
+                "persist.vendor.fingerprint.authenticate_timeout_ms",
+                "persist.vendor.fingerprint.binder_threads",
+                "persist.vendor.fingerprint.boost.uclamp_min",
+                "persist.vendor.fingerprint.boost.cpus",
+                "persist.vendor.fingerprint.watchdog_ms",
+};
+
+const FingerprintConfigSnapshot& FingerprintConfig::snapshot() {
+    uint32_t areaSerial = __system_property_area_serial();
+    const FingerprintConfigSnapshot* current = mCurrent.load(std::memory_order_acquire);
+    if (current != nullptr && areaSerial == mAreaSerial.load(std::memory_order_acquire)) {
+        return *current;
+    }
+    return refresh(areaSerial);
+}
+
+const FingerprintConfigSnapshot& FingerprintConfig::refresh(uint32_t areaSerial) {
+    std::lock_guard<std::mutex> lock(mRefreshLock);
+
+    bool changed = mCurrent.load(std::memory_order_relaxed) == nullptr;
+    for (size_t i = 0; i < kPropertyCount; i++) {
+        // Properties that are not set yet have no prop_info; look them up again next time.
+        if (mPropInfos[i] == nullptr) mPropInfos[i] = __system_property_find(kPropertyNames[i]);
+        uint32_t serial = mPropInfos[i] ? __system_property_serial(mPropInfos[i]) : 0;
+        if (serial != mPropSerials[i]) {
+            mPropSerials[i] = serial;
+            changed = true;
+        }
+    }
+
+    if (changed) {
+        auto next = std::make_unique<FingerprintConfigSnapshot>(FingerprintConfigSnapshot{
+                .type = get<std::string>("type"),
+                .sensorId = get<std::int32_t>("sensor_id"),
+                .sensorLocation = parseSensorLocation(get<std::string>("sensor_location")),
+                .sensorStrength = get<std::int32_t>("sensor_strength"),
+                .navigationGuesture = get<bool>("navigation_guesture"),
+                .detectInteraction = get<bool>("detect_interaction"),
+                .displayTouch = get<bool>("display_touch"),
+                .controlIllumination = get<bool>("control_illumination"),
+                .touchInput = get<bool>("touch_input"),
+                .touchDevice = get<std::string>("touch_device"),
+                .pressNotify = get<bool>("press_notify"),
+                .powerKeyDevice = get<std::string>("power_key_device"),
+                .hitTest =
+                        {
+                                .marginPx = get<std::int32_t>("touch_margin"),
+                                .scalePercent = get<std::int32_t>("display_scale_percent"),
+                                .maxContactPx = get<std::int32_t>("palm_size"),
+                        },
+                .authenticateTimeoutMs = get<std::int32_t>("authenticate_timeout_ms"),
+                .binderThreads = get<std::int32_t>("binder_threads"),
+                .boost =
+                        {
+                                .uclampMin = get<std::int32_t>("boost_uclamp_min"),
+                                .cpus = get<std::string>("boost_cpus"),
+                        },
+                .watchdogMs = get<std::int32_t>("watchdog_ms"),
+        });
+        mCurrent.store(next.get(), std::memory_order_release);
+        mSnapshots.push_back(std::move(next));
+    }
+    mAreaSerial.store(areaSerial, std::memory_order_release);
+    return *mCurrent.load(std::memory_order_relaxed);
+}
+
+SensorLocation FingerprintConfig::parseSensorLocation(const std::string& loc) {
+    SensorLocation location;
+
+    auto isValidStr = false;
+    auto dim = Util::split(loc, ":");
+
+    if (dim.size() < 3 or dim.size() > 4) {
+        if (!loc.empty()) LOG(WARNING) << "Invalid sensor location input (x:y:radius):" + loc;
+        return location;
+    } else {
+        int32_t x, y, r;
+        std::string d = "";
+        if (dim.size() >= 3) {
+            isValidStr = ParseInt(dim[0], &x) && ParseInt(dim[1], &y) && ParseInt(dim[2], &r);
+        }
+        if (dim.size() >= 4) {
+            d = dim[3];
+        }
+        if (isValidStr)
+            location = {.sensorLocationX = x, .sensorLocationY = y, .sensorRadius = r, .display = d};
+
+        return location;
+    }
+}
+
 }  // namespace aidl::android::hardware::biometrics::fingerprint
@@ -15,11 +15,16 @@
  */
 
 #include "FingerprintEngine.h"
+#include <algorithm>
+#include <iterator>
 #include <regex>
 #include "Fingerprint.h"
+#include "FingerprintTrace.h"
+#include "PooledCallable.h"
 
 #include <android-base/logging.h>
-#include <android-base/parseint.h>
+#include <android-base/properties.h>
+#include <android-base/stringprintf.h>
 
 #include <fingerprint.sysprop.h>
 
@@ -27,69 +32,483 @@
 #include "util/Util.h"
 
 using namespace ::android::fingerprint::peridot;
-using ::android::base::ParseInt;
 
 namespace aidl::android::hardware::biometrics::fingerprint {
+namespace {
+constexpr std::string_view kLocalHbmOn = DISP_PARAM_LOCAL_HBM_MODE " " DISP_PARAM_LOCAL_HBM_ON;
+constexpr std::string_view kLocalHbmOff = DISP_PARAM_LOCAL_HBM_MODE " " DISP_PARAM_LOCAL_HBM_OFF;
+constexpr char kStatePath[] = "/data/vendor/fingerprint/state";
+// Set by init.fingerprint.rc once the directories in /data/vendor exist.
+constexpr char kDataReadyProp[] = "vendor.fps_hal.data_ready";
+
+int64_t bootTimeNs() {
+    timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+}  // namespace
+
+template <typename Call>
+auto FingerprintEngine::watched(const char* name, Call&& call) {
+    using Result = decltype(call(mDevice));
+    if (mWorker->isAbandonedThread()) {
+        // The device this task was meant for is gone, mDevice belongs to the new worker.
+        return Result(FINGERPRINT_ERROR_HW_UNAVAILABLE);
+    }
+    // Only calls on the worker can be given up on when they hang.
+    DCHECK(mWorker->isWorkerThread()) << name << " called off the worker";
+    if (mDevice == nullptr) {
+        LOG(ERROR) << name << ": no vendor device";
+        return Result(FINGERPRINT_ERROR_HW_UNAVAILABLE);
+    }
+    DeviceWatchdog::Scope scope(&mWatchdog, name, Fingerprint::cfg().snapshot().watchdogMs);
+    Result result = call(mDevice);
+    if (scope.abandoned()) {
+        // A fresh worker owns the engine by now. The task unwinds on the failure, every later
+        // device call and hardware write on this thread is skipped.
+        LOG(ERROR) << name << " returned after the watchdog gave up on it";
+        return Result(FINGERPRINT_ERROR_HW_UNAVAILABLE);
+    }
+    return result;
+}
 
 FingerprintEngine::FingerprintEngine()
-    : isLockoutTimerSupported(true) {
-    if (mDevice) {
-        LOG(INFO) << "Fingerprint HAL already opened";
+    : mDevice(nullptr),
+      mNotify(Fingerprint::nextNotify()),
+      mFodStatusNode(FOD_STATUS_PATH),
+      mDispParamNode(DISP_PARAM_PATH),
+      mFod(nullptr),
+      mWorker(nullptr),
+      mTimers(nullptr),
+      mOperationTimedOut(false),
+      mUiReadyTimeouts(0),
+      mHbmSafetyTimeouts(0),
+      mOperationTimeouts(0),
+      mBoostTimeouts(0),
+      mQueuedOperation(0),
+      mQueuedOperationName(nullptr),
+      mQueuedOperationStarted(false),
+      mRunningOperation(0),
+      mRunningOperationName(nullptr),
+      mRunningInDevice(false),
+      mPreemptedOperation(0),
+      mCancelStartNs(0),
+      mCancelRequests(0),
+      mPreemptions(0),
+      mPreemptTimeouts(0),
+      mStaleOperations(0),
+      isLockoutTimerSupported(true),
+      mActiveGroup(-1),
+      mActiveGroupLoads(0),
+      mActiveGroupSkips(0),
+      mTouchSlot(-1),
+      mTouchHbmNs(0),
+      mTouchDowns(0),
+      mTouchDeduped(0),
+      mPressNs(0),
+      mPressDowns(0),
+      mWakeNs(0),
+      mProbeTimeNs(0),
+      mProbeCached(false),
+      mSnapshot(kStatePath),
+      mWarmStart(false),
+      mCachedAuthenticatorIds(0),
+      mDataReady(false),
+      mIsDestructing(false),
+      mStartupNs(0),
+      mHalReadyBootNs(0),
+      mDataReadyBootNs(0),
+      mFirstGroupBootNs(0),
+      mRecentHangs(0),
+      mLastHangNs(0),
+      mRecoveries(0),
+      mRecoveryFailures(0),
+      mWatchdog([this](const char* call, int64_t startNs, std::thread::id caller) {
+          onDeviceHang(call, startNs, caller);
+      }) {
+    int64_t start = Util::getSystemNanoTime();
+    mFodMachines.push_back(std::make_unique<FodStateMachine>(static_cast<FodActuator*>(this)));
+    mFod = mFodMachines.back().get();
+
+    std::string cached = FingerprintHalProperties::cached_module().value_or("");
+    if (!cached.empty()) {
+        mDevice = openModule(cached);
+        if (mDevice) {
+            mModule = cached;
+            mProbeCached = true;
+        } else {
+            LOG(WARNING) << "Cached fingerprint module " << cached << " failed, probing all";
+        }
+    }
+    if (!mDevice) {
+        mDevice = probeModules(cached, &mModule);
+    }
+    mProbeTimeNs = Util::getSystemNanoTime() - start;
+
+    if (!mDevice) {
+        LOG(ERROR) << "Can't open any fingerprint HAL module";
+        return;
+    }
+    LOG(INFO) << "Using fingerprint HAL " << mModule << ", found in "
+              << mProbeTimeNs / 1000000.0 << "ms" << (mProbeCached ? " (cached)" : "");
+
+    if (mDevice->set_notify(mDevice, mNotify) != 0) {
+        LOG(ERROR) << "Can't register fingerprint module callback";
+    }
+    if (!mProbeCached) {
+        FingerprintHalProperties::cached_module(mModule);
+    }
+}
+
+const hw_module_t* FingerprintEngine::loadModule(const std::string& module) {
+    std::string class_name;
+    std::string class_module_id;
+
+    auto parts = Util::split(module, ":");
+
+    if (parts.size() == 2) {
+        class_name = parts[0];
+        class_module_id = parts[1];
     } else {
-        for (auto& [module] : kModules) {
-            std::string class_name;
-            std::string class_module_id;
-
-            auto parts = Util::split(module, ":");
-
-            if (parts.size() == 2) {
-                class_name = parts[0];
-                class_module_id = parts[1];
-            } else {
-                class_name = module;
-                class_module_id = FINGERPRINT_HARDWARE_MODULE_ID;
+        class_name = module;
+        class_module_id = FINGERPRINT_HARDWARE_MODULE_ID;
+    }
+
+    const hw_module_t* hw_mdl = nullptr;
+    if (hw_get_module_by_class(class_module_id.c_str(), class_name.c_str(), &hw_mdl) != 0 ||
+        !hw_mdl) {
+        LOG(ERROR) << "Can't open HAL module, class: " << class_name
+                   << ", module_id: " << class_module_id;
+        return nullptr;
+    }
+    return hw_mdl;
+}
+
+fingerprint_device_t* FingerprintEngine::openModule(const std::string& module,
+                                                    const hw_module_t* hw_mdl) {
+    int64_t start = Util::getSystemNanoTime();
+    if (!hw_mdl) {
+        hw_mdl = loadModule(module);
+        if (!hw_mdl) return nullptr;
+    }
+    fingerprint_device_t* device = openFingerprintHal(hw_mdl);
+    double elapsedMs = (Util::getSystemNanoTime() - start) / 1000000.0;
+    if (!device) {
+        LOG(ERROR) << "Can't open fingerprint HAL " << module << " (" << elapsedMs << "ms)";
+        return nullptr;
+    }
+    LOG(INFO) << "Opened fingerprint HAL " << module << " (" << elapsedMs << "ms)";
+    return device;
+}
+
+fingerprint_device_t* FingerprintEngine::probeModules(const std::string& skip,
+                                                      std::string* opened) {
+    // Loading a candidate is a dlopen that touches no hardware, so all of them load at once.
+    // Their devices all drive the same sensor though: open them one at a time, in the priority
+    // order of kModules, and keep the first that opens.
+    std::vector<std::pair<std::string, std::future<const hw_module_t*>>> candidates;
+    for (auto& [module] : kModules) {
+        if (skip == module) continue;
+        candidates.emplace_back(module, std::async(std::launch::async, [module] {
+                                    return loadModule(module);
+                                }));
+    }
+    for (auto& [module, loaded] : candidates) {
+        const hw_module_t* hw_mdl = loaded.get();
+        if (!hw_mdl) continue;
+        fingerprint_device_t* device = openModule(module, hw_mdl);
+        if (device) {
+            *opened = module;
+            return device;
+        }
+    }
+    return nullptr;
+}
+
+void FingerprintEngine::attach(WorkScheduler* worker, TimerService* timers) {
+    mWorker = worker;
+    mTimers = timers;
+
+    const auto& config = Fingerprint::cfg().snapshot();
+    if (config.touchInput && config.type.starts_with("udfps")) {
+        mTouchReader = std::make_unique<TouchInputReader>(
+                [this](int32_t slot, int32_t x, int32_t y, int64_t timeNs) {
+                    onTouchDown(slot, x, y, timeNs);
+                },
+                [this](int32_t slot, int64_t timeNs) { onTouchUp(slot, timeNs); });
+        if (!mTouchReader->start(config.touchDevice)) {
+            mTouchReader.reset();
+        }
+    }
+    if (config.pressNotify && config.type.starts_with("udfps")) {
+        mPressWatcher = std::make_unique<FodPressWatcher>(
+                [this](bool pressed, int64_t timeNs) { onFodPress(pressed, timeNs); });
+        if (!mPressWatcher->start(FOD_STATUS_PATH)) {
+            mPressWatcher.reset();
+        }
+    }
+}
+
+bool FingerprintEngine::acceptTouch(int32_t x, int32_t y, float minor, float major) {
+    const auto& config = Fingerprint::cfg().snapshot();
+    HitTestResult result = hitTest(config.sensorLocation, config.hitTest, x, y, minor, major);
+    mHitTests[static_cast<size_t>(result)].fetch_add(1, std::memory_order_relaxed);
+    return result == HitTestResult::kAccepted;
+}
+
+void FingerprintEngine::onTouchDown(int32_t slot, int32_t x, int32_t y, int64_t /*timeNs*/) {
+    // The touch node reports no contact size here, so only the position is checked.
+    if (!acceptTouch(x, y, 0.0f, 0.0f)) {
+        return;
+    }
+    beginEarlyDown(slot, x, y);
+}
+
+void FingerprintEngine::onFodPress(bool pressed, int64_t timeNs) {
+    // The driver wrote the node, what we wrote last is no longer what it holds.
+    mFodStatusNode.invalidate();
+    if (!pressed) {
+        onTouchUp(kPressSlot, timeNs);
+        return;
+    }
+    // The touch IC only reports presses inside the sensor area, nothing to hit-test.
+    const SensorLocation& location = Fingerprint::cfg().snapshot().sensorLocation;
+    if (beginEarlyDown(kPressSlot, location.sensorLocationX, location.sensorLocationY)) {
+        mPressNs = timeNs;
+        mPressDowns++;
+    }
+}
+
+bool FingerprintEngine::beginEarlyDown(int32_t slot, int32_t x, int32_t y) {
+    {
+        // Only while the vendor waits for a finger, otherwise every tap on the sensor area
+        // would flash local HBM.
+        std::lock_guard<std::mutex> lock(mOperationLock);
+        if (mRunningOperation == 0 || !mRunningInDevice) return false;
+    }
+    int32_t idle = -1;
+    if (!mTouchSlot.compare_exchange_strong(idle, slot)) {
+        return false;
+    }
+
+    mMetrics.beginUnlock();
+    int32_t pointerId = kTouchPointerBase + slot;
+    mWorker->schedule(WorkScheduler::TaskKind::kPointerDown, Callable::from([this, pointerId, x, y] {
+        if (mLockoutTracker.getMode() != LockoutTracker::LockoutMode::kNone) return;
+        onPointerDownImpl(pointerId, x, y, 0.0f, 0.0f);
+        mTouchHbmNs = Util::getSystemNanoTime();
+        mTouchDowns++;
+    }), pointerId);
+    return true;
+}
+
+void FingerprintEngine::onTouchUp(int32_t slot, int64_t /*timeNs*/) {
+    if (mTouchSlot != slot) {
+        return;
+    }
+    int32_t pointerId = kTouchPointerBase + slot;
+    mWorker->schedule(WorkScheduler::TaskKind::kPointerUp, Callable::from([this, pointerId] {
+        onPointerUpImpl(pointerId);
+    }), pointerId);
+}
+
+void FingerprintEngine::beginUnlock() {
+    if (mTouchSlot < 0) mMetrics.beginUnlock();
+}
+
+void FingerprintEngine::armTimer(TimerSlot* slot, int64_t delayMs, WorkScheduler::TaskKind kind,
+                                 std::function<void()> action) {
+    std::lock_guard<std::mutex> lock(mTimerLock);
+    mTimers->cancel(slot->id);
+    uint64_t seq = ++slot->seq;
+    slot->id = mTimers->schedule(delayMs, [this, slot, seq, kind, action = std::move(action)] {
+        mWorker->schedule(kind, Callable::from([this, slot, seq, action] {
+            {
+                std::lock_guard<std::mutex> lock(mTimerLock);
+                if (slot->seq != seq) return;
+                slot->id = TimerService::kInvalidTimer;
             }
+            action();
+        }));
+    });
+}
+
+void FingerprintEngine::cancelTimer(TimerSlot* slot) {
+    std::lock_guard<std::mutex> lock(mTimerLock);
+    mTimers->cancel(slot->id);
+    slot->id = TimerService::kInvalidTimer;
+    slot->seq++;
+}
+
+void FingerprintEngine::onSessionClosed() {
+    cancelTimer(&mLockoutTimer);
+    cancelTimer(&mUiReadyTimer);
+    cancelTimer(&mHbmSafetyTimer);
+    cancelTimer(&mOperationTimer);
+    endBoost();
+}
 
-            mDevice = openFingerprintHal(class_name.c_str(), class_module_id.c_str());
-            if (!mDevice) {
-                LOG(ERROR) << "Can't open HAL module, class: " << class_name.c_str() 
-                    << ", module_id: " << class_module_id.c_str();
-                continue;
+void FingerprintEngine::onOperationFinished() {
+    mWakeNs = 0;
+    cancelTimer(&mOperationTimer);
+    endBoost();
+    dispatchFod(FodEvent::kReset);
+
+    std::lock_guard<std::mutex> lock(mOperationLock);
+    if (mRunningOperation != 0) {
+        ATRACE_ASYNC_END(mRunningOperationName, static_cast<int32_t>(mRunningOperation));
+    }
+    mRunningOperation = 0;
+    mRunningInDevice = false;
+    if (mCancelStartNs != 0) {
+        mCancelToIdle.record(Util::getSystemNanoTime() - mCancelStartNs);
+        mCancelStartNs = 0;
+    }
+}
+
+uint64_t FingerprintEngine::queueOperation(const char* name) {
+    std::lock_guard<std::mutex> lock(mOperationLock);
+    if (mQueuedOperation != 0 && !mQueuedOperationStarted) {
+        // Superseded before it reached the device.
+        ATRACE_ASYNC_END(mQueuedOperationName, static_cast<int32_t>(mQueuedOperation));
+    }
+    mQueuedOperationName = name;
+    mQueuedOperationStarted = false;
+    ATRACE_ASYNC_BEGIN(name, static_cast<int32_t>(mQueuedOperation + 1));
+    return ++mQueuedOperation;
+}
+
+bool FingerprintEngine::startOperation(uint64_t op) {
+    uint64_t preempted = 0;
+    {
+        std::lock_guard<std::mutex> lock(mOperationLock);
+        if (op != mQueuedOperation) {
+            // The framework already asked for something newer, running this would only make
+            // the new operation wait for it.
+            mStaleOperations++;
+            return false;
+        }
+        if (mRunningOperation != 0) {
+            mPreemptions++;
+            ATRACE_ASYNC_END(mRunningOperationName, static_cast<int32_t>(mRunningOperation));
+            if (mRunningInDevice) {
+                preempted = mRunningOperation;
+                mPreemptedOperation = preempted;
             }
-            LOG(INFO) << "Opened fingerprint HAL, class: " << class_name.c_str() 
-                << ", module_id: " << class_module_id.c_str();
-            break;
         }
-        if (!mDevice) {
-            LOG(ERROR) << "Can't open any fingerprint HAL module";
+        mRunningOperation = op;
+        mRunningOperationName = mQueuedOperationName;
+        mRunningInDevice = true;
+        mQueuedOperationStarted = true;
+    }
+    if (preempted != 0) {
+        LOG(INFO) << "Preempting operation " << preempted << " still running in the device";
+        cancelTimer(&mOperationTimer);
+        cancelInDevice(preempted);
+    }
+    return true;
+}
+
+void FingerprintEngine::cancelInDevice(uint64_t op) {
+    {
+        std::lock_guard<std::mutex> lock(mOperationLock);
+        mPreemptedOperation = op;
+    }
+    deviceCancel();
+
+    std::unique_lock<std::mutex> lock(mOperationLock);
+    if (!mPreemptedCond.wait_for(lock, std::chrono::milliseconds(kPreemptTimeoutMs),
+                                 [this] { return mPreemptedOperation == 0; })) {
+        // The vendor finished it on its own instead, no CANCELED is coming.
+        LOG(WARNING) << "No CANCELED for preempted operation " << op << " within "
+                     << kPreemptTimeoutMs << "ms";
+        mPreemptedOperation = 0;
+        mPreemptTimeouts++;
+    }
+}
+
+void FingerprintEngine::cancelOperation(uint64_t op) {
+    bool inDevice;
+    {
+        std::lock_guard<std::mutex> lock(mOperationLock);
+        mCancelRequests++;
+        if (op != mQueuedOperation) {
+            return;
+        }
+        if (mCancelStartNs == 0) mCancelStartNs = Util::getSystemNanoTime();
+        if (op != mRunningOperation) {
+            // Not in the device yet, the queued task sees the signal and reports CANCELED.
+            return;
         }
+        inDevice = mRunningInDevice;
     }
+    FP_TRACE_CALL();
+    LOG(DEBUG) << __func__;
+    if (!inDevice) {
+        // Nothing in the vendor device would answer, the CANCELED is made up here.
+        fingerprint_msg_t msg = {};
+        msg.type = FINGERPRINT_ERROR;
+        msg.data.error = FINGERPRINT_ERROR_CANCELED;
+        Fingerprint::inject(msg);
+        return;
+    }
+    cancelTimer(&mOperationTimer);
+    deviceCancel();
+    // Don't wait for the vendor to drop local HBM and the press state.
+    onPointerUpImpl(0);
+    dispatchFod(FodEvent::kReset);
 }
 
-void FingerprintEngine::setActiveGroup(int userId) {
-    LOG(INFO) << __func__;
-    auto path = std::format("/data/vendor_de/{}/fpdata/", userId);
-    uint64_t error = mDevice->setActiveGroup(mDevice, userId, path.c_str());
-    if (error) {
-        LOG(INFO) << "Failed to set active group: " << error;
+bool FingerprintEngine::interceptNotify(const fingerprint_msg_t& msg) {
+    if (msg.type != FINGERPRINT_ERROR || msg.data.error != FINGERPRINT_ERROR_CANCELED) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mOperationLock);
+    if (mPreemptedOperation == 0) {
+        return false;
     }
+    LOG(INFO) << "Dropping CANCELED of preempted operation " << mPreemptedOperation;
+    mPreemptedOperation = 0;
+    mPreemptedCond.notify_all();
+    return true;
 }
 
-fingerprint_device_t* FingerprintEngine::openFingerprintHal(const char* class_name,
-                                                      const char* module_id) {
-    const hw_module_t* hw_mdl = nullptr;
+bool FingerprintEngine::consumeOperationTimeout() {
+    std::lock_guard<std::mutex> lock(mTimerLock);
+    return std::exchange(mOperationTimedOut, false);
+}
 
-    LOG(INFO) << "Opening fingerprint hal library...";
-    if (hw_get_module_by_class(module_id, class_name, &hw_mdl) != 0) {
-        LOG(ERROR) << "Can't open fingerprint HW Module";
-        return nullptr;
+void FingerprintEngine::setActiveGroup(int userId) {
+    FP_TRACE_CALL();
+    LOG(DEBUG) << __func__;
+    waitForData();
+    if (userId == mActiveGroup) {
+        // Templates of this user are still loaded in the TEE.
+        mActiveGroupSkips++;
+        return;
     }
+    auto path = std::format("/data/vendor_de/{}/fpdata/", userId);
+    uint64_t error = watched("setActiveGroup", [userId, &path](fingerprint_device_t* device) {
+        return device->setActiveGroup(device, userId, path.c_str());
+    });
+    if (mWorker->isAbandonedThread()) return;
+    mActiveGroupLoads++;
+    if (error) {
+        LOG(INFO) << "Failed to set active group: " << error;
+        mActiveGroup = -1;
+        return;
+    }
+    mActiveGroup = userId;
 
-    if (!hw_mdl) {
-        LOG(ERROR) << "No valid fingerprint module";
-        return nullptr;
+    int64_t none = 0;
+    int64_t now = bootTimeNs();
+    if (mFirstGroupBootNs.compare_exchange_strong(none, now)) {
+        LOG(INFO) << "First unlock possible " << now / 1000000 << "ms after boot";
     }
+}
 
+fingerprint_device_t* FingerprintEngine::openFingerprintHal(const hw_module_t* hw_mdl) {
+    LOG(INFO) << "Opening fingerprint hal device...";
     auto module = reinterpret_cast<const fingerprint_module_t*>(hw_mdl);
     if (!module->common.methods->open) {
         LOG(ERROR) << "No valid open method";
@@ -104,64 +523,192 @@ fingerprint_device_t* FingerprintEngine::openFingerprintHal(const char* class_na
 
     if (module->common.module_api_version != FINGERPRINT_MODULE_API_VERSION_2_1) {
         LOG(ERROR) << "Hardware version dosesn't match FINGERPRINT_MODULE_API_VERSION_2_1: " << module->common.module_api_version;
+        device->close(device);
         return nullptr;
     }
 
-    auto fp_device = reinterpret_cast<fingerprint_device_t*>(device);
-    if (fp_device->set_notify(fp_device, Fingerprint::notify) != 0) {
+    return reinterpret_cast<fingerprint_device_t*>(device);
+}
+
+void FingerprintEngine::onDeviceHang(const char* call, int64_t startNs, std::thread::id caller) {
+    {
+        std::lock_guard<std::mutex> lock(mRecoveryLock);
+        if (startNs - mLastHangNs > kHangWindowMs * 1000000) mRecentHangs = 0;
+        mLastHangNs = startNs;
+        if (++mRecentHangs > kMaxHangs) {
+            LOG(FATAL) << "Vendor device hung " << mRecentHangs << " times within "
+                       << kHangWindowMs << "ms, last in " << call;
+        }
+        // The stuck call may hold the lock of the current machine.
+        mFodMachines.push_back(std::make_unique<FodStateMachine>(static_cast<FodActuator*>(this)));
+        mFod.store(mFodMachines.back().get(), std::memory_order_release);
+    }
+    // Anything the hung device still reports is about operations failed below.
+    mNotify = Fingerprint::nextNotify();
+
+    if (!mWorker->abandonThread(caller, Callable::from([this, startNs] {
+            recoverDevice(startNs, 0);
+        }))) {
+        // Whatever that thread holds stays held, nothing short of a restart gets it back.
+        LOG(FATAL) << call << " hung outside the worker";
+    }
+
+    // Whatever waits for the device now would never hear back from it.
+    fingerprint_msg_t msg = {};
+    msg.type = FINGERPRINT_ERROR;
+    msg.data.error = FINGERPRINT_ERROR_HW_UNAVAILABLE;
+    Fingerprint::inject(msg);
+}
+
+void FingerprintEngine::recoverDevice(int64_t hangStartNs, uint32_t attempt) {
+    FP_TRACE_CALL();
+    int64_t timeoutMs = Fingerprint::cfg().snapshot().watchdogMs;
+    // The new state machine starts idle, take the panel and the touch IC there too. Whatever
+    // they did meanwhile, the writes have to reach them.
+    mFodStatusNode.invalidate();
+    mDispParamNode.invalidate();
+    cancelLocalHbm();
+    setLocalHbm(false);
+    setFodStatus(false);
+
+    // Closing may unblock the stuck call, or hang as well: the device is dropped first so the
+    // recovery started by that hang goes straight to reopening it.
+    if (fingerprint_device_t* device = std::exchange(mDevice, nullptr)) {
+        DeviceWatchdog::Scope scope(&mWatchdog, "close", timeoutMs);
+        device->common.close(&device->common);
+        if (scope.abandoned()) return;
+    }
+    fingerprint_device_t* device;
+    {
+        DeviceWatchdog::Scope scope(&mWatchdog, "open", timeoutMs);
+        device = openModule(mModule);
+        // Too late, another recovery owns mDevice now.
+        if (scope.abandoned()) return;
+    }
+    if (device == nullptr) {
+        {
+            std::lock_guard<std::mutex> lock(mRecoveryLock);
+            mRecoveryFailures++;
+        }
+        if (attempt + 1 >= kMaxRecoveryAttempts) {
+            LOG(FATAL) << "Can't reopen " << mModule << " after " << attempt + 1 << " attempts";
+        }
+        // Calls meanwhile fail with HW_UNAVAILABLE.
+        LOG(ERROR) << "Can't reopen " << mModule << ", retrying in " << kRecoveryRetryMs << "ms";
+        armTimer(&mRecoveryTimer, kRecoveryRetryMs, WorkScheduler::TaskKind::kRecovery,
+                 [this, hangStartNs, attempt] { recoverDevice(hangStartNs, attempt + 1); });
+        return;
+    }
+    mDevice = device;
+    if (mDevice->set_notify(mDevice, mNotify) != 0) {
         LOG(ERROR) << "Can't register fingerprint module callback";
-        return nullptr;
     }
 
-    return fp_device;
+    // The templates of the active user went away with the old device.
+    int userId = std::exchange(mActiveGroup, -1);
+    if (userId >= 0) setActiveGroup(userId);
+
+    int64_t elapsedNs = Util::getSystemNanoTime() - hangStartNs;
+    {
+        std::lock_guard<std::mutex> lock(mRecoveryLock);
+        mRecoveries++;
+        mRecoveryTime.record(elapsedNs);
+    }
+    LOG(INFO) << "Vendor device recovered " << elapsedNs / 1000000 << "ms after the hang began";
 }
 
 void FingerprintEngine::onAcquired(int32_t result, int32_t vendorCode) {
-    LOG(INFO) << __func__;
-    LOG(INFO) << " result: " << result << " vendorCode: " << vendorCode;
+    FP_TRACE_CALL();
+    LOG(DEBUG) << __func__ << " result: " << result << " vendorCode: " << vendorCode;
     if (result != FINGERPRINT_ACQUIRED_VENDOR) {
-        setFingerStatus(false);
-        if (result == FINGERPRINT_ACQUIRED_GOOD) setFodStatus(FOD_STATUS_OFF);
-    } else if (vendorCode == 21 || vendorCode == 23) {
-        /*
-         * vendorCode = 21 waiting for fingerprint authentication
-         * vendorCode = 23 waiting for fingerprint enroll
-         */
-        setFodStatus(FOD_STATUS_ON);
-    } else if (vendorCode == 44) {
-        /* vendorCode = 44 fingerprint scan failed */
-        setFingerStatus(false);
+        dispatchFod(result == FINGERPRINT_ACQUIRED_GOOD ? FodEvent::kAcquiredGood
+                                                        : FodEvent::kAcquired);
+    } else if (vendorCode == FINGERPRINT_ACQUIRED_VENDOR_WAITING_AUTHENTICATE ||
+               vendorCode == FINGERPRINT_ACQUIRED_VENDOR_WAITING_ENROLL) {
+        dispatchFod(FodEvent::kWaitingForFinger);
+    } else if (vendorCode == FINGERPRINT_ACQUIRED_VENDOR_SCAN_FAILED) {
+        dispatchFod(FodEvent::kScanFailed);
     }
 }
 
-void FingerprintEngine::setFodStatus(int value) {
-    set(FOD_STATUS_PATH, value);
+void FingerprintEngine::dispatchFod(FodEvent event, int32_t x, int32_t y) {
+    if (mWorker->isWorkerThread()) {
+        fod().dispatch(event, x, y);
+    } else if (!mWorker->isAbandonedThread()) {
+        // Never evicted, a lost reset would leave the sensor armed.
+        mWorker->schedule(WorkScheduler::TaskKind::kFodEvent,
+                          pooledCallable([this, event, x, y] { fod().dispatch(event, x, y); }));
+    }
 }
 
-void FingerprintEngine::setFingerStatus(bool pressed) {
-    LOG(INFO) << __func__;
-    mDevice->goodixExtCmd(mDevice, COMMAND_FOD_PRESS_STATUS, pressed ? PARAM_FOD_PRESSED : PARAM_FOD_RELEASED);
-    mDevice->goodixExtCmd(mDevice, COMMAND_NIT, pressed ? PARAM_NIT_FOD : PARAM_NIT_NONE);
+void FingerprintEngine::setFodStatus(bool on) {
+    if (mWorker->isAbandonedThread()) return;
+    // The watcher would take the notification of this write for a finger.
+    if (mPressWatcher) mPressWatcher->noteHalWrite(on ? FOD_STATUS_ON : FOD_STATUS_OFF);
+    mFodStatusNode.write(on ? FOD_STATUS_ON : FOD_STATUS_OFF);
+}
+
+void FingerprintEngine::setPressCoordinates(int32_t x, int32_t y) {
+    watched("goodixExtCmd", [x, y](fingerprint_device_t* device) {
+        device->goodixExtCmd(device, COMMAND_FOD_PRESS_X, x);
+        return device->goodixExtCmd(device, COMMAND_FOD_PRESS_Y, y);
+    });
+}
+
+void FingerprintEngine::setPressStatus(bool pressed) {
+    FP_TRACE_CALL();
+    watched("goodixExtCmd", [pressed](fingerprint_device_t* device) {
+        device->goodixExtCmd(device, COMMAND_FOD_PRESS_STATUS,
+                             pressed ? PARAM_FOD_PRESSED : PARAM_FOD_RELEASED);
+        return device->goodixExtCmd(device, COMMAND_NIT, pressed ? PARAM_NIT_FOD : PARAM_NIT_NONE);
+    });
+    if (pressed) {
+        mMetrics.mark(FingerprintMetrics::Stage::kPressCmd);
+        if (int64_t pressNs = mPressNs.exchange(0)) {
+            mPressToCapture.record(Util::getSystemNanoTime() - pressNs);
+        }
+    }
+}
 
-    set(DISP_PARAM_PATH,
-        std::string(DISP_PARAM_LOCAL_HBM_MODE) + " " +
-                (pressed ? DISP_PARAM_LOCAL_HBM_ON : DISP_PARAM_LOCAL_HBM_OFF));
+void FingerprintEngine::setLocalHbm(bool on) {
+    FP_TRACE_CALL();
+    if (mWorker->isAbandonedThread()) return;
+    // The stuck ramp holds the node, and turns local HBM off itself once it is done.
+    if (!on && mIllumination.isUndoPending()) return;
+    mDispParamNode.write(on ? kLocalHbmOn : kLocalHbmOff);
+    ATRACE_INT(kTraceHbm, on ? 1 : 0);
+    if (on) mMetrics.mark(FingerprintMetrics::Stage::kLocalHbm);
 }
 
-template <typename T>
-void FingerprintEngine::set(const std::string &path, const T &value){
-    std::ofstream file(path);
-    file << value;
+void FingerprintEngine::beginLocalHbm() {
+    if (mWorker->isAbandonedThread()) return;
+    mIllumination.start([this] { setLocalHbm(true); });
+}
+
+void FingerprintEngine::finishLocalHbm() {
+    // On a timeout the press goes out anyway, the vendor retries the capture on its own.
+    mIllumination.wait(kIlluminationTimeoutMs);
+}
+
+void FingerprintEngine::cancelLocalHbm() {
+    // A ramp that outlived finishLocalHbm()'s timeout is still queued or running. Should it be
+    // stuck as well, the worker moves on and the panel is turned off once the ramp returns.
+    mIllumination.cancel(kIlluminationTimeoutMs, [this] { setLocalHbm(false); });
 }
 
 void FingerprintEngine::generateChallengeImpl(ISessionCallback* /*cb*/) {
-    LOG(INFO) << __func__;
-    mDevice->generateChallenge(mDevice);
+    FP_TRACE_CALL();
+    LOG(DEBUG) << __func__;
+    watched("generateChallenge",
+            [](fingerprint_device_t* device) { return device->generateChallenge(device); });
 }
 
 void FingerprintEngine::revokeChallengeImpl(ISessionCallback* /*cb*/, int64_t challenge) {
-    LOG(INFO) << __func__;
-    uint64_t error = mDevice->revokeChallenge(mDevice, challenge);
+    FP_TRACE_CALL();
+    LOG(DEBUG) << __func__;
+    uint64_t error = watched("revokeChallenge", [challenge](fingerprint_device_t* device) {
+        return device->revokeChallenge(device, challenge);
+    });
     if (error) {
         LOG(ERROR) << "Failed to revoke challenge=" << challenge
                     << " error=" << error;
@@ -171,45 +718,119 @@ void FingerprintEngine::revokeChallengeImpl(ISessionCallback* /*cb*/, int64_t ch
 void FingerprintEngine::enrollImpl(ISessionCallback* cb,
                                        const keymaster::HardwareAuthToken& hat,
                                        const std::future<void>& /*cancel*/) {
-    LOG(INFO) << __func__;
+    FP_TRACE_CALL();
+    LOG(DEBUG) << __func__;
+    boostOperation();
 
     hw_auth_token_t authToken;
     translate(hat, authToken);
-    int error = mDevice->enroll(mDevice, &authToken);
+    int error = watched("enroll", [&authToken](fingerprint_device_t* device) {
+        return device->enroll(device, &authToken);
+    });
     if (error){
+        if (mWorker->isAbandonedThread()) return;
         LOG(ERROR) << "enroll failed: " << error;
+        onOperationFinished();
         cb->onError(Error::UNABLE_TO_PROCESS, error);
+        return;
     }
+    armOperationDeadline(kEnrollTimeoutMs);
 
 }
 
 void FingerprintEngine::authenticateImpl(ISessionCallback* cb, int64_t operationId,
                                              const std::future<void>& /*cancel*/) {
-    LOG(INFO) << __func__;
+    FP_TRACE_CALL();
+    LOG(DEBUG) << __func__;
+    boostOperation();
 
-    int error = mDevice->authenticate(mDevice, operationId);
+    int error = deviceAuthenticate(operationId);
     if (error) {
+        if (mWorker->isAbandonedThread()) return;
         LOG(ERROR) << "authenticate failed: " << error;
+        onOperationFinished();
         cb->onError(Error::UNABLE_TO_PROCESS, error);
+        return;
     }
+    // Keyguard keeps authenticate running indefinitely, so this deadline is opt-in.
+    auto timeoutMs = Fingerprint::cfg().snapshot().authenticateTimeoutMs;
+    if (timeoutMs > 0) armOperationDeadline(timeoutMs);
+}
+
+int FingerprintEngine::deviceAuthenticate(int64_t operationId) {
+    return watched("authenticate", [operationId](fingerprint_device_t* device) {
+        return device->authenticate(device, operationId);
+    });
+}
+
+void FingerprintEngine::deviceCancel() {
+    watched("cancel", [](fingerprint_device_t* device) { return device->cancel(device); });
+}
+
+void FingerprintEngine::boostOperation() {
+    const auto& policy = Fingerprint::cfg().snapshot().boost;
+    if (!policy.enabled()) {
+        return;
+    }
+    if (mBoost.begin(policy)) mMetrics.setBoosted(true);
+    armTimer(&mBoostTimer, kBoostTimeoutMs, WorkScheduler::TaskKind::kTerminal, [this] {
+        LOG(DEBUG) << "No finger within " << kBoostTimeoutMs << "ms, dropping the boost";
+        {
+            std::lock_guard<std::mutex> lock(mTimerLock);
+            mBoostTimeouts++;
+        }
+        mBoost.end();
+        mMetrics.setBoosted(false);
+    });
+}
+
+void FingerprintEngine::endBoost() {
+    cancelTimer(&mBoostTimer);
+    mBoost.end();
+    mMetrics.setBoosted(false);
+}
+
+void FingerprintEngine::armOperationDeadline(int64_t timeoutMs) {
+    {
+        std::lock_guard<std::mutex> lock(mTimerLock);
+        mOperationTimedOut = false;
+    }
+    armTimer(&mOperationTimer, timeoutMs, WorkScheduler::TaskKind::kTerminal, [this, timeoutMs] {
+        LOG(WARNING) << "Operation did not finish within " << timeoutMs << "ms, cancelling";
+        {
+            std::lock_guard<std::mutex> lock(mTimerLock);
+            mOperationTimedOut = true;
+            mOperationTimeouts++;
+        }
+        deviceCancel();
+    });
 }
 
 void FingerprintEngine::detectInteractionImpl(ISessionCallback* cb,
                                                   const std::future<void>& /*cancel*/) {
-    LOG(INFO) << __func__;
+    FP_TRACE_CALL();
+    LOG(DEBUG) << __func__;
 
-    auto detectInteractionSupported = Fingerprint::cfg().get<bool>("detect_interaction");
+    auto detectInteractionSupported = Fingerprint::cfg().snapshot().detectInteraction;
     if (!detectInteractionSupported) {
         LOG(ERROR) << "Detect interaction is not supported";
+        onOperationFinished();
         cb->onError(Error::UNABLE_TO_PROCESS, 0 /* vendorError */);
         return;
     }
+    // Runs until cancelled or preempted without anything in the vendor device, which will
+    // neither need cancelling nor send CANCELED.
+    std::lock_guard<std::mutex> lock(mOperationLock);
+    mRunningInDevice = false;
 }
 
 void FingerprintEngine::enumerateEnrollmentsImpl(ISessionCallback* cb) {
-    LOG(INFO) << __func__;
-    int error = mDevice->enumerate(mDevice);
+    FP_TRACE_CALL();
+    LOG(DEBUG) << __func__;
+    int error = watched("enumerate",
+                        [](fingerprint_device_t* device) { return device->enumerate(device); });
     if (error) {
+        if (mWorker->isAbandonedThread()) return;
         LOG(ERROR) << "enumerate failed: " << error;
         cb->onError(Error::UNABLE_TO_PROCESS, error);
     }
@@ -217,30 +838,144 @@ void FingerprintEngine::enumerateEnrollmentsImpl(ISessionCallback* cb) {
 
 void FingerprintEngine::removeEnrollmentsImpl(ISessionCallback * /*cb*/,
                                               const std::vector<int32_t> &enrollmentIds){
-    LOG(INFO) << __func__;
-    mDevice->remove(mDevice, enrollmentIds.data(), enrollmentIds.size());
+    FP_TRACE_CALL();
+    LOG(DEBUG) << __func__;
+    watched("remove", [&enrollmentIds](fingerprint_device_t* device) {
+        return device->remove(device, enrollmentIds.data(), enrollmentIds.size());
+    });
 }
 
-void FingerprintEngine::getAuthenticatorIdImpl(ISessionCallback* /*cb*/) {
-    LOG(INFO) << __func__;
-    mDevice->getAuthenticatorId(mDevice);
+void FingerprintEngine::getAuthenticatorIdImpl(ISessionCallback* cb) {
+    FP_TRACE_CALL();
+    LOG(DEBUG) << __func__;
+    PersistentState state = mSnapshot.state();
+    for (const auto& entry : state.authenticatorIds) {
+        if (mActiveGroup >= 0 && entry.userId == mActiveGroup) {
+            mCachedAuthenticatorIds++;
+            cb->onAuthenticatorIdRetrieved(entry.id);
+            return;
+        }
+    }
+    watched("getAuthenticatorId",
+            [](fingerprint_device_t* device) { return device->getAuthenticatorId(device); });
 }
 
 void FingerprintEngine::invalidateAuthenticatorIdImpl(ISessionCallback* /*cb*/) {
-    LOG(INFO) << __func__;
-    mDevice->invalidateAuthenticatorId(mDevice);
+    FP_TRACE_CALL();
+    LOG(DEBUG) << __func__;
+    onEnrollmentsChanged();
+    watched("invalidateAuthenticatorId", [](fingerprint_device_t* device) {
+        return device->invalidateAuthenticatorId(device);
+    });
+}
+
+void FingerprintEngine::onAuthenticatorId(int64_t id) {
+    int userId = mActiveGroup;
+    if (userId < 0) {
+        return;
+    }
+    mSnapshot.update([userId, id](PersistentState* state) {
+        auto& ids = state->authenticatorIds;
+        auto slot = std::find_if(std::begin(ids), std::end(ids),
+                                 [userId](const auto& entry) { return entry.userId == userId; });
+        if (slot == std::end(ids)) {
+            slot = std::find_if(std::begin(ids), std::end(ids),
+                                [](const auto& entry) { return entry.userId < 0; });
+        }
+        if (slot == std::end(ids)) {
+            slot = &ids[userId % PersistentState::kMaxUsers];
+        }
+        *slot = {userId, id};
+    });
+}
+
+void FingerprintEngine::onEnrollmentsChanged() {
+    int userId = mActiveGroup;
+    mSnapshot.update([userId](PersistentState* state) {
+        for (auto& entry : state->authenticatorIds) {
+            if (entry.userId == userId) entry = {-1, 0};
+        }
+    });
+}
+
+FingerprintEngine::~FingerprintEngine() {
+    {
+        std::lock_guard<std::mutex> lock(mDataLock);
+        mIsDestructing = true;
+    }
+    if (mDataThread.joinable()) mDataThread.join();
+}
+
+void FingerprintEngine::onStarted(int64_t durationNs) {
+    mStartupNs = durationNs;
+    mHalReadyBootNs = bootTimeNs();
+    LOG(INFO) << "Ready " << mHalReadyBootNs / 1000000 << "ms after boot, start took "
+              << durationNs / 1000000.0 << "ms";
+    mDataThread = std::thread([this] { dataThreadFunc(); });
+}
+
+void FingerprintEngine::dataThreadFunc() {
+    using namespace std::chrono_literals;
+    while (!::android::base::WaitForProperty(kDataReadyProp, "1", 1s)) {
+        std::lock_guard<std::mutex> lock(mDataLock);
+        if (mIsDestructing) return;
+    }
+
+    mWarmStart = mSnapshot.load();
+    mLockoutTracker.attach(&mSnapshot);
+    int64_t durationNs = mStartupNs;
+    mSnapshot.update([this, durationNs](PersistentState* state) {
+        state->starts++;
+        if (mWarmStart) {
+            state->warmStarts++;
+            state->lastWarmStartNs = durationNs;
+        } else {
+            state->lastColdStartNs = durationNs;
+        }
+    });
+
+    {
+        std::lock_guard<std::mutex> lock(mDataLock);
+        mDataReady = true;
+        mDataReadyBootNs = bootTimeNs();
+    }
+    mDataCond.notify_all();
+    LOG(INFO) << "/data ready " << mDataReadyBootNs / 1000000 << "ms after boot, "
+              << (mWarmStart ? "warm" : "cold") << " start";
+}
+
+void FingerprintEngine::waitForData() {
+    std::unique_lock<std::mutex> lock(mDataLock);
+    if (!mDataReady) {
+        FP_TRACE_NAME("FpWaitForData");
+        LOG(INFO) << "Waiting for /data";
+        mDataCond.wait(lock, [this] { return mDataReady; });
+    }
+}
+
+void FingerprintEngine::recordUnlock(bool success) {
+    mSnapshot.update([success](PersistentState* state) { state->unlocks[success ? 1 : 0]++; });
+    if (int64_t wakeNs = mWakeNs.load(); success && wakeNs != 0) {
+        mWakeToUnlock.record(Util::getSystemNanoTime() - wakeNs);
+    }
+}
+
+void FingerprintEngine::markWake(int64_t timeNs) {
+    int64_t none = 0;
+    mWakeNs.compare_exchange_strong(none, timeNs);
 }
 
 void FingerprintEngine::resetLockoutImpl(ISessionCallback* cb,
                                              const keymaster::HardwareAuthToken& hat) {
-    LOG(INFO) << __func__;
+    FP_TRACE_CALL();
+    LOG(DEBUG) << __func__;
     if (hat.mac.empty()) {
         LOG(ERROR) << "Fail: hat in resetLockout()";
         cb->onError(Error::UNABLE_TO_PROCESS, 0 /* vendorError */);
         return;
     }
     clearLockout(cb);
-    if (isLockoutTimerStarted) isLockoutTimerAborted = true;
+    cancelTimer(&mLockoutTimer);
 }
 
 void FingerprintEngine::clearLockout(ISessionCallback* cb, bool dueToTimeout) {
@@ -248,58 +983,147 @@ void FingerprintEngine::clearLockout(ISessionCallback* cb, bool dueToTimeout) {
     mLockoutTracker.reset(dueToTimeout);
 }
 
-ndk::ScopedAStatus FingerprintEngine::onPointerDownImpl(int32_t /*pointerId*/, int32_t x,
+ndk::ScopedAStatus FingerprintEngine::onPointerDownImpl(int32_t pointerId, int32_t x,
                                                             int32_t y, float /*minor*/,
                                                             float /*major*/) {
-    LOG(INFO) << __func__;
+    FP_TRACE_CALL();
+    LOG(DEBUG) << __func__;
+    if (mTouchHbmNs != 0 && pointerId < kTouchPointerBase) {
+        // The touch node was faster, the sensor is already armed for this finger.
+        mTouchLead.record(Util::getSystemNanoTime() - mTouchHbmNs);
+        mTouchDeduped++;
+        return ndk::ScopedAStatus::ok();
+    }
+    mMetrics.mark(FingerprintMetrics::Stage::kEngineDown);
+    markWake(Util::getSystemNanoTime());
+    boostOperation();
+    armTimer(&mUiReadyTimer, kUiReadyTimeoutMs, WorkScheduler::TaskKind::kUiReady, [this] {
+        LOG(WARNING) << "onUiReady() did not arrive within " << kUiReadyTimeoutMs << "ms";
+        std::lock_guard<std::mutex> lock(mTimerLock);
+        mUiReadyTimeouts++;
+    });
+    // Not evictable: with the pointer up lost this is the only thing left to turn local HBM off.
+    armTimer(&mHbmSafetyTimer, kHbmSafetyTimeoutMs, WorkScheduler::TaskKind::kIllumination, [this] {
+        LOG(WARNING) << "onPointerUp() did not arrive within " << kHbmSafetyTimeoutMs
+                     << "ms, turning off local HBM";
+        {
+            std::lock_guard<std::mutex> lock(mTimerLock);
+            mHbmSafetyTimeouts++;
+        }
+        onPointerUpImpl(0);
+    });
     // mDevice->onPointerDown(mDevice, pointerId, x, y, minor, major);
-    mDevice->goodixExtCmd(mDevice, COMMAND_FOD_PRESS_X, x);
-    mDevice->goodixExtCmd(mDevice, COMMAND_FOD_PRESS_Y, y);
-    setFingerStatus(true);
-
-    // verify whetehr touch coordinates/area matching sensor location ?
+    dispatchFod(FodEvent::kFingerDown, x, y);
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus FingerprintEngine::onPointerUpImpl(int32_t /*pointerId*/) {
-    LOG(INFO) << __func__;
+    FP_TRACE_CALL();
+    LOG(DEBUG) << __func__;
+    cancelTimer(&mUiReadyTimer);
+    cancelTimer(&mHbmSafetyTimer);
+    mTouchHbmNs = 0;
+    mTouchSlot = -1;
 
     // mDevice->onPointerUp(mDevice, pointerId);
-    mDevice->goodixExtCmd(mDevice, COMMAND_FOD_PRESS_X, 0);
-    mDevice->goodixExtCmd(mDevice, COMMAND_FOD_PRESS_Y, 0);
-    setFingerStatus(false);
+    dispatchFod(FodEvent::kFingerUp);
     return ndk::ScopedAStatus::ok();
 }
 
+void FingerprintEngine::postPointerUp() {
+    mWorker->schedule(WorkScheduler::TaskKind::kPointerUp,
+                      pooledCallable([this] { onPointerUpImpl(kVendorPointer); }), kVendorPointer);
+}
+
 ndk::ScopedAStatus FingerprintEngine::onUiReadyImpl() {
-    LOG(INFO) << __func__;
+    FP_TRACE_CALL();
+    LOG(DEBUG) << __func__;
+    cancelTimer(&mUiReadyTimer);
     return ndk::ScopedAStatus::ok();
 }
 
 SensorLocation FingerprintEngine::getSensorLocation() {
-    SensorLocation location;
-
-    auto loc = Fingerprint::cfg().get<std::string>("sensor_location");
-    auto isValidStr = false;
-    auto dim = Util::split(loc, ":");
-
-    if (dim.size() < 3 or dim.size() > 4) {
-        if (!loc.empty()) LOG(WARNING) << "Invalid sensor location input (x:y:radius):" + loc;
-        return location;
-    } else {
-        int32_t x, y, r;
-        std::string d = "";
-        if (dim.size() >= 3) {
-            isValidStr = ParseInt(dim[0], &x) && ParseInt(dim[1], &y) && ParseInt(dim[2], &r);
-        }
-        if (dim.size() >= 4) {
-            d = dim[3];
-        }
-        if (isValidStr)
-            location = {.sensorLocationX = x, .sensorLocationY = y, .sensorRadius = r, .display = d};
+    return Fingerprint::cfg().snapshot().sensorLocation;
+}
 
-        return location;
+std::string FingerprintEngine::toString() const {
+    std::string out = "----- FingerprintEngine -----\n";
+    ::android::base::StringAppendF(&out, "module=%s probe=%.2fms%s\n", mModule.c_str(),
+                                   mProbeTimeNs / 1000000.0, mProbeCached ? " (cached)" : "");
+    ::android::base::StringAppendF(&out, "activeGroup=%d loads=%llu skips=%llu\n", mActiveGroup,
+                                   static_cast<unsigned long long>(mActiveGroupLoads),
+                                   static_cast<unsigned long long>(mActiveGroupSkips));
+    out += mSnapshot.toString();
+    {
+        std::lock_guard<std::mutex> lock(mDataLock);
+        ::android::base::StringAppendF(
+                &out, "boot: halReady=%lldms dataReady=%lldms firstActiveGroup=%lldms\n",
+                static_cast<long long>(mHalReadyBootNs / 1000000),
+                static_cast<long long>(mDataReadyBootNs / 1000000),
+                static_cast<long long>(mFirstGroupBootNs.load() / 1000000));
+    }
+    ::android::base::StringAppendF(&out, "%s start, cachedAuthenticatorIds=%llu\n",
+                                   mWarmStart ? "warm" : "cold",
+                                   static_cast<unsigned long long>(mCachedAuthenticatorIds));
+    auto hits = [this](HitTestResult result) {
+        return static_cast<unsigned long long>(mHitTests[static_cast<size_t>(result)].load());
+    };
+    ::android::base::StringAppendF(&out, "touches accepted=%llu outside=%llu tooLarge=%llu\n",
+                                   hits(HitTestResult::kAccepted), hits(HitTestResult::kOutside),
+                                   hits(HitTestResult::kTooLarge));
+    if (mTouchReader) {
+        out += mTouchReader->toString();
+        ::android::base::StringAppendF(&out, "touchDowns=%llu deduped=%llu lead %s\n",
+                                       static_cast<unsigned long long>(mTouchDowns.load()),
+                                       static_cast<unsigned long long>(mTouchDeduped.load()),
+                                       mTouchLead.toString().c_str());
+    }
+    if (mPressWatcher) {
+        out += mPressWatcher->toString();
+        ::android::base::StringAppendF(&out, "pressDowns=%llu press to capture %s\n",
+                                       static_cast<unsigned long long>(mPressDowns.load()),
+                                       mPressToCapture.toString().c_str());
     }
+    ::android::base::StringAppendF(&out, "wake to unlock (%s) %s\n", typeName(),
+                                   mWakeToUnlock.toString().c_str());
+    out += mBoost.toString();
+    out += mWatchdog.toString();
+    {
+        std::lock_guard<std::mutex> lock(mRecoveryLock);
+        ::android::base::StringAppendF(&out,
+                                       "recoveries=%llu recoveryFailures=%llu recentHangs=%u\n"
+                                       "  recovery %s\n",
+                                       static_cast<unsigned long long>(mRecoveries),
+                                       static_cast<unsigned long long>(mRecoveryFailures),
+                                       mRecentHangs, mRecoveryTime.toString().c_str());
+    }
+    out += fod().toString();
+    out += mIllumination.toString();
+    out += mFodStatusNode.toString();
+    out += mDispParamNode.toString();
+    {
+        std::lock_guard<std::mutex> lock(mTimerLock);
+        ::android::base::StringAppendF(&out,
+                                       "uiReadyTimeouts=%llu hbmSafetyTimeouts=%llu "
+                                       "operationTimeouts=%llu boostTimeouts=%llu\n",
+                                       static_cast<unsigned long long>(mUiReadyTimeouts),
+                                       static_cast<unsigned long long>(mHbmSafetyTimeouts),
+                                       static_cast<unsigned long long>(mOperationTimeouts),
+                                       static_cast<unsigned long long>(mBoostTimeouts));
+    }
+    {
+        std::lock_guard<std::mutex> lock(mOperationLock);
+        ::android::base::StringAppendF(&out,
+                                       "cancelRequests=%llu preemptions=%llu preemptTimeouts=%llu "
+                                       "staleOperations=%llu\n"
+                                       "cancel to idle %s\n",
+                                       static_cast<unsigned long long>(mCancelRequests),
+                                       static_cast<unsigned long long>(mPreemptions),
+                                       static_cast<unsigned long long>(mPreemptTimeouts),
+                                       static_cast<unsigned long long>(mStaleOperations),
+                                       mCancelToIdle.toString().c_str());
+    }
+    return out;
 }
 
 std::pair<AcquiredInfo, int32_t> FingerprintEngine::convertAcquiredInfo(int32_t code) {
@@ -328,38 +1152,38 @@ std::pair<Error, int32_t> FingerprintEngine::convertError(int32_t code) {
 
 bool FingerprintEngine::checkSensorLockout(ISessionCallback* cb) {
     LockoutTracker::LockoutMode lockoutMode = mLockoutTracker.getMode();
+    ATRACE_INT(kTraceLockout, static_cast<int32_t>(lockoutMode));
     if (lockoutMode == LockoutTracker::LockoutMode::kPermanent) {
         LOG(ERROR) << "Fail: lockout permanent";
         cb->onLockoutPermanent();
-        isLockoutTimerAborted = true;
+        cancelTimer(&mLockoutTimer);
         return true;
     } else if (lockoutMode == LockoutTracker::LockoutMode::kTimed) {
         int64_t timeLeft = mLockoutTracker.getLockoutTimeLeft();
         LOG(ERROR) << "Fail: lockout timed " << timeLeft;
         cb->onLockoutTimed(timeLeft);
-        if (isLockoutTimerSupported && !isLockoutTimerStarted) startLockoutTimer(timeLeft, cb);
+        if (isLockoutTimerSupported && !getLockoutTimerStarted()) startLockoutTimer(timeLeft, cb);
         return true;
     }
     return false;
 }
 
 void FingerprintEngine::startLockoutTimer(int64_t timeout, ISessionCallback* cb) {
-    LOG(INFO) << __func__;
-    std::function<void(ISessionCallback*)> action =
-            std::bind(&FingerprintEngine::lockoutTimerExpired, this, std::placeholders::_1);
-    std::thread([timeout, action, cb]() {
-        std::this_thread::sleep_for(std::chrono::milliseconds(timeout));
-        action(cb);
-    }).detach();
+    FP_TRACE_CALL();
+    LOG(DEBUG) << __func__;
+    // The slot is cancelled when the session closes, so cb outlives any pending expiry.
+    armTimer(&mLockoutTimer, timeout, WorkScheduler::TaskKind::kTerminal,
+             [this, cb] { lockoutTimerExpired(cb); });
+}
 
-    isLockoutTimerStarted = true;
+bool FingerprintEngine::getLockoutTimerStarted() {
+    std::lock_guard<std::mutex> lock(mTimerLock);
+    return mLockoutTimer.id != TimerService::kInvalidTimer;
 }
+
 void FingerprintEngine::lockoutTimerExpired(ISessionCallback* cb) {
-    LOG(INFO) << __func__;
-    if (!isLockoutTimerAborted) {
-        clearLockout(cb, true);
-    }
-    isLockoutTimerStarted = false;
-    isLockoutTimerAborted = false;
+    FP_TRACE_CALL();
+    LOG(DEBUG) << __func__;
+    clearLockout(cb, true);
 }
 }  // namespace aidl::android::hardware::biometrics::fingerprint
@@ -16,14 +16,14 @@
 
 #include "FingerprintEngineRear.h"
 
-#include <android-base/logging.h>
-#include <android-base/parseint.h>
 
-#include <fingerprint.sysprop.h>
-
-#include "util/CancellationSignal.h"
 #include "util/Util.h"
 
-using namespace ::android::fingerprint::peridot;
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+void FingerprintEngineRear::onAcquired(int32_t /*result*/, int32_t /*vendorCode*/) {
+    // Nothing to light up or press, the sensor captures on its own.
+    markWake(Util::getSystemNanoTime());
+}
 
-namespace aidl::android::hardware::biometrics::fingerprint {}
+}  // namespace aidl::android::hardware::biometrics::fingerprint
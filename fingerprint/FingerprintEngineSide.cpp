@@ -17,21 +17,249 @@
 #include "FingerprintEngineSide.h"
 
 #include <android-base/logging.h>
+#include <android-base/stringprintf.h>
 
-#include <fingerprint.sysprop.h>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <stdlib.h>
+#include <unistd.h>
 
-#include "util/CancellationSignal.h"
+#include "Fingerprint.h"
+#include "FingerprintTrace.h"
 #include "util/Util.h"
 
-using namespace ::android::fingerprint::peridot;
+#undef LOG_TAG
+#define LOG_TAG "FingerprintHalSide"
 
 namespace aidl::android::hardware::biometrics::fingerprint {
 
-FingerprintEngineSide::FingerprintEngineSide() : FingerprintEngine() {}
+FingerprintEngineSide::FingerprintEngineSide()
+    : FingerprintEngine(),
+      mSpeculation(Speculation::kIdle),
+      mHeldMatch{},
+      mSpeculations(0),
+      mAdopted(0),
+      mReplayed(0),
+      mExpired(0),
+      mDisplayOff(0),
+      mHeldFailures(0) {}
 
 SensorLocation FingerprintEngineSide::defaultSensorLocation() {
     return SensorLocation{.sensorLocationX = defaultSensorLocationX,
                           .sensorLocationY = defaultSensorLocationY,
                           .sensorRadius = defaultSensorRadius};
 }
+
+SensorLocation FingerprintEngineSide::getSensorLocation() {
+    SensorLocation location = FingerprintEngine::getSensorLocation();
+    return location.sensorRadius > 0 ? location : defaultSensorLocation();
+}
+
+void FingerprintEngineSide::attach(WorkScheduler* worker, TimerService* timers) {
+    FingerprintEngine::attach(worker, timers);
+
+    const std::string& device = Fingerprint::cfg().snapshot().powerKeyDevice;
+    if (!device.empty()) {
+        mBrightnessFd.reset(TEMP_FAILURE_RETRY(open(kBrightnessPath, O_RDONLY | O_CLOEXEC)));
+        if (!mBrightnessFd.ok()) {
+            // Without it every press looks like one turning the display off.
+            PLOG(WARNING) << "Failed to open " << kBrightnessPath
+                          << ", not authenticating on the power key";
+        }
+        mPowerKey = std::make_unique<KeyInputReader>(
+                KEY_POWER, [this](int64_t timeNs) { onPowerKey(timeNs); });
+        if (!mPowerKey->start(device)) {
+            mPowerKey.reset();
+        }
+    }
+}
+
+void FingerprintEngineSide::onAcquired(int32_t /*result*/, int32_t /*vendorCode*/) {
+    // No display involvement. Without the power key reader the first capture is the wakeup.
+    markWake(Util::getSystemNanoTime());
+}
+
+void FingerprintEngineSide::onPowerKey(int64_t timeNs) {
+    if (isDisplayOn()) {
+        // This press turns the display off, or opens the power menu. Nothing is waiting to be
+        // unlocked, so a match from the wakeup before it must not unlock the next one.
+        mWorker->schedule(WorkScheduler::TaskKind::kCancel, Callable::from([this] {
+                              if (dropSpeculation()) {
+                                  std::lock_guard<std::mutex> lock(mSpeculationLock);
+                                  mDisplayOff++;
+                              }
+                          }));
+        return;
+    }
+    markWake(timeNs);
+    mWorker->schedule(WorkScheduler::TaskKind::kWake, Callable::from([this] { speculate(); }));
+}
+
+bool FingerprintEngineSide::isDisplayOn() {
+    // Read at key down, before the press itself changes anything. On AOD the backlight is lit
+    // too, so a press waking the display from AOD doesn't speculate.
+    char buf[16];
+    ssize_t size = mBrightnessFd.ok() ? TEMP_FAILURE_RETRY(pread(mBrightnessFd.get(), buf,
+                                                                 sizeof(buf) - 1, 0))
+                                      : -1;
+    if (size <= 0) return true;
+    buf[size] = '\0';
+    return atoi(buf) > 0;
+}
+
+void FingerprintEngineSide::speculate() {
+    {
+        std::lock_guard<std::mutex> lock(mOperationLock);
+        // The framework is already authenticating, or about to.
+        if (mRunningOperation != 0 || (mQueuedOperation != 0 && !mQueuedOperationStarted)) return;
+    }
+    if (mLockoutTracker.getMode() != LockoutTracker::LockoutMode::kNone) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mSpeculationLock);
+        if (mSpeculation != Speculation::kIdle) return;
+        mSpeculation = Speculation::kRunning;
+        mSpeculations++;
+    }
+
+    FP_TRACE_NAME("FpWakeAuthenticate");
+    LOG(DEBUG) << "Power key pressed, authenticating ahead of keyguard";
+    boostOperation();
+    if (int error = deviceAuthenticate(0); error != 0) {
+        if (mWorker->isAbandonedThread()) return;
+        LOG(ERROR) << "authenticate failed: " << error;
+        std::lock_guard<std::mutex> lock(mSpeculationLock);
+        mSpeculation = Speculation::kIdle;
+        return;
+    }
+    armTimer(&mSpeculationTimer, kSpeculationTimeoutMs, WorkScheduler::TaskKind::kTerminal,
+             [this] { expireSpeculation(); });
+}
+
+void FingerprintEngineSide::expireSpeculation() {
+    if (!dropSpeculation()) return;
+    LOG(INFO) << "No authenticate within " << kSpeculationTimeoutMs
+              << "ms of the power key, dropped its capture";
+    std::lock_guard<std::mutex> lock(mSpeculationLock);
+    mExpired++;
+}
+
+bool FingerprintEngineSide::dropSpeculation() {
+    bool running;
+    {
+        std::lock_guard<std::mutex> lock(mSpeculationLock);
+        if (mSpeculation != Speculation::kRunning && mSpeculation != Speculation::kMatched) {
+            return false;
+        }
+        running = mSpeculation == Speculation::kRunning;
+        if (!running) mSpeculation = Speculation::kIdle;
+        mHeldMatch = {};
+    }
+    cancelTimer(&mSpeculationTimer);
+    if (running) {
+        // Held back as kRunning until the vendor's CANCELED, which the base class drops, so
+        // nothing of it reaches an operation the framework starts next.
+        cancelInDevice(kSpeculativeOperation);
+        if (mWorker->isAbandonedThread()) return true;
+        std::lock_guard<std::mutex> lock(mSpeculationLock);
+        mSpeculation = Speculation::kIdle;
+        mHeldMatch = {};
+    }
+    endBoost();
+    return true;
+}
+
+bool FingerprintEngineSide::interceptNotify(const fingerprint_msg_t& msg) {
+    if (FingerprintEngine::interceptNotify(msg)) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(mSpeculationLock);
+    switch (mSpeculation) {
+        case Speculation::kIdle:
+        case Speculation::kMatched:
+            return false;
+        case Speculation::kRunning:
+            if (msg.type == FINGERPRINT_ACQUIRED) {
+                return true;
+            }
+            if (msg.type == FINGERPRINT_AUTHENTICATED) {
+                if (msg.data.authenticated.finger.fid == 0) {
+                    // Not worth replaying, but it counts towards the lockout all the same.
+                    mHeldFailures++;
+                    mLockoutTracker.addFailedAttempt();
+                    return true;
+                }
+                mHeldMatch = msg;
+                mSpeculation = Speculation::kMatched;
+                return true;
+            }
+            if (msg.type == FINGERPRINT_ERROR) {
+                mSpeculation = Speculation::kIdle;
+                return true;
+            }
+            return false;
+    }
+    return false;
+}
+
+void FingerprintEngineSide::authenticateImpl(ISessionCallback* cb, int64_t operationId,
+                                             const std::future<void>& cancel) {
+    // Keyguard authenticates with operation ID 0, anything else needs a token for its own
+    // challenge and can't use the capture.
+    if (operationId != 0) {
+        dropSpeculation();
+        if (mWorker->isAbandonedThread()) return;
+        FingerprintEngine::authenticateImpl(cb, operationId, cancel);
+        return;
+    }
+
+    Speculation state;
+    fingerprint_msg_t match;
+    {
+        std::lock_guard<std::mutex> lock(mSpeculationLock);
+        state = mSpeculation;
+        match = mHeldMatch;
+        if (state == Speculation::kRunning || state == Speculation::kMatched) {
+            mSpeculation = Speculation::kIdle;
+            mHeldMatch = {};
+            (state == Speculation::kRunning ? mAdopted : mReplayed)++;
+        }
+    }
+    if (state != Speculation::kRunning && state != Speculation::kMatched) {
+        FingerprintEngine::authenticateImpl(cb, operationId, cancel);
+        return;
+    }
+    cancelTimer(&mSpeculationTimer);
+
+    if (state == Speculation::kRunning) {
+        FP_TRACE_NAME("FpAdoptAuthenticate");
+        LOG(DEBUG) << "Adopting the authenticate started by the power key";
+        boostOperation();
+        auto timeoutMs = Fingerprint::cfg().snapshot().authenticateTimeoutMs;
+        if (timeoutMs > 0) armOperationDeadline(timeoutMs);
+    } else {
+        FP_TRACE_NAME("FpReplayMatch");
+        LOG(DEBUG) << "Replaying the match made after the power key";
+        Fingerprint::inject(match);
+    }
+}
+
+std::string FingerprintEngineSide::toString() const {
+    std::string out = FingerprintEngine::toString();
+    out += "----- FingerprintEngineSide -----\n";
+    if (mPowerKey) out += mPowerKey->toString();
+    std::lock_guard<std::mutex> lock(mSpeculationLock);
+    ::android::base::StringAppendF(
+            &out,
+            "speculations=%llu adopted=%llu replayed=%llu expired=%llu displayOff=%llu "
+            "heldFailures=%llu\n",
+            static_cast<unsigned long long>(mSpeculations),
+            static_cast<unsigned long long>(mAdopted), static_cast<unsigned long long>(mReplayed),
+            static_cast<unsigned long long>(mExpired),
+            static_cast<unsigned long long>(mDisplayOff),
+            static_cast<unsigned long long>(mHeldFailures));
+    return out;
+}
+
 }  // namespace aidl::android::hardware::biometrics::fingerprint
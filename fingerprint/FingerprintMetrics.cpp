@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "FingerprintMetrics.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <android-base/stringprintf.h>
+
+#include "util/Util.h"
+
+using ::android::base::StringAppendF;
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+void LatencyHistogram::record(int64_t durationNs) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mSamples[mNext] = durationNs;
+    mNext = (mNext + 1) % kWindowSize;
+    mCount++;
+    mMax = std::max(mMax, durationNs);
+}
+
+uint64_t LatencyHistogram::count() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mCount;
+}
+
+std::string LatencyHistogram::toString() const {
+    std::vector<int64_t> samples;
+    uint64_t count;
+    int64_t max;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        count = mCount;
+        max = mMax;
+        samples.assign(mSamples.begin(),
+                       mSamples.begin() + std::min<uint64_t>(mCount, kWindowSize));
+    }
+    if (samples.empty()) {
+        return "n=0";
+    }
+
+    std::sort(samples.begin(), samples.end());
+    auto percentileMs = [&samples](int p) {
+        size_t index = (samples.size() - 1) * p / 100;
+        return samples[index] / 1000000.0;
+    };
+    return ::android::base::StringPrintf("n=%llu p50=%.2fms p90=%.2fms p99=%.2fms max=%.2fms",
+                                         static_cast<unsigned long long>(count), percentileMs(50),
+                                         percentileMs(90), percentileMs(99), max / 1000000.0);
+}
+
+const char* FingerprintMetrics::stageName(size_t stage) {
+    switch (static_cast<Stage>(stage)) {
+        case Stage::kPointerDown:
+            return "total";
+        case Stage::kEngineDown:
+            return "worker_queue";
+        case Stage::kPressCmd:
+            return "press_cmd";
+        case Stage::kLocalHbm:
+            return "local_hbm";
+        case Stage::kFirstAcquired:
+            return "first_acquired";
+        case Stage::kAuthenticated:
+            return "authenticated";
+        default:
+            return "unknown";
+    }
+}
+
+void FingerprintMetrics::beginUnlock() {
+    std::lock_guard<std::mutex> lock(mLock);
+    mStamps.fill(0);
+    mStamps[static_cast<size_t>(Stage::kPointerDown)] = Util::getSystemNanoTime();
+    mActive = true;
+    mUnlockBoosted = mBoosted;
+}
+
+void FingerprintMetrics::setBoosted(bool boosted) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mBoosted = boosted;
+    if (mActive && boosted) mUnlockBoosted = true;
+}
+
+void FingerprintMetrics::mark(Stage stage) {
+    std::lock_guard<std::mutex> lock(mLock);
+    int64_t& stamp = mStamps[static_cast<size_t>(stage)];
+    if (mActive && stamp == 0) {
+        stamp = Util::getSystemNanoTime();
+    }
+}
+
+void FingerprintMetrics::endUnlock(bool success) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (!mActive) {
+        return;
+    }
+    mActive = false;
+    mStamps[static_cast<size_t>(Stage::kAuthenticated)] = Util::getSystemNanoTime();
+
+    auto& histograms = mHistograms[mUnlockBoosted ? 1 : 0][success ? 1 : 0];
+    int64_t previous = mStamps[0];
+    for (size_t stage = 1; stage < kStageCount; stage++) {
+        // Stages that were skipped (e.g. no press command on a lockout) are folded into the next.
+        if (mStamps[stage] == 0) continue;
+        histograms[stage].record(mStamps[stage] - previous);
+        previous = mStamps[stage];
+    }
+    histograms[0].record(previous - mStamps[0]);
+}
+
+std::string FingerprintMetrics::toString() const {
+    std::string out = "----- Unlock latency (from onPointerDown) -----\n";
+    for (int boosted = 0; boosted <= 1; boosted++) {
+        for (int success = 1; success >= 0; success--) {
+            const auto& histograms = mHistograms[boosted][success];
+            // Boosted unlocks only exist with a boost policy set.
+            if (boosted && histograms[0].count() == 0) continue;
+            StringAppendF(&out, "%s%s:\n", success ? "success" : "failure",
+                          boosted ? " (boosted)" : "");
+            for (size_t stage = 0; stage < kStageCount; stage++) {
+                StringAppendF(&out, "  %-16s %s\n", stageName(stage),
+                              histograms[stage].toString().c_str());
+            }
+        }
+    }
+    return out;
+}
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_TAG "FingerprintHalPress"
+
+#include "FodPressWatcher.h"
+
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iterator>
+
+#include "FingerprintTrace.h"
+#include "util/Util.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+FodPressWatcher::FodPressWatcher(Handler handler)
+    : mHandler(std::move(handler)), mLast(0), mHalValue(0), mHalWriteNs(0) {}
+
+FodPressWatcher::~FodPressWatcher() {
+    if (mThread.joinable()) {
+        uint64_t one = 1;
+        TEMP_FAILURE_RETRY(write(mStopFd.get(), &one, sizeof(one)));
+        mThread.join();
+    }
+}
+
+bool FodPressWatcher::start(const char* path) {
+    mPath = path;
+    mFd.reset(TEMP_FAILURE_RETRY(open(path, O_RDONLY | O_CLOEXEC)));
+    mStopFd.reset(eventfd(0, EFD_CLOEXEC));
+    if (!mFd.ok() || !mStopFd.ok()) {
+        PLOG(ERROR) << "Failed to open " << path;
+        return false;
+    }
+    // sysfs only notifies after the attribute has been read once.
+    mLast = std::max(readValue(), 0);
+
+    mThread = std::thread([this] { threadFunc(); });
+    LOG(INFO) << "Watching " << path << " for presses";
+    return true;
+}
+
+void FodPressWatcher::noteHalWrite(int value) {
+    std::lock_guard<std::mutex> lock(mHalWriteLock);
+    mHalValue = value ? 1 : 0;
+    mHalWriteNs = Util::getSystemNanoTime();
+}
+
+bool FodPressWatcher::isHalWrite(int value, int64_t timeNs) {
+    std::lock_guard<std::mutex> lock(mHalWriteLock);
+    if (mHalWriteNs == 0 || value != mHalValue ||
+        timeNs - mHalWriteNs > kOwnWriteWindowMs * 1000000) {
+        return false;
+    }
+    mHalWriteNs = 0;
+    return true;
+}
+
+int FodPressWatcher::readValue() {
+    char buf[8];
+    ssize_t size = TEMP_FAILURE_RETRY(pread(mFd.get(), buf, sizeof(buf), 0));
+    if (size <= 0) {
+        PLOG(ERROR) << "Failed to read " << mPath;
+        return -1;
+    }
+    return buf[0] == '0' ? 0 : 1;
+}
+
+void FodPressWatcher::threadFunc() {
+    pollfd fds[] = {
+            {.fd = mFd.get(), .events = POLLPRI | POLLERR},
+            {.fd = mStopFd.get(), .events = POLLIN},
+    };
+
+    while (true) {
+        int count = TEMP_FAILURE_RETRY(poll(fds, std::size(fds), -1));
+        if (count < 0) {
+            PLOG(ERROR) << "poll failed";
+            return;
+        }
+        if (fds[1].revents & POLLIN) {
+            return;
+        }
+        if (!(fds[0].revents & (POLLPRI | POLLERR))) {
+            continue;
+        }
+
+        int64_t now = Util::getSystemNanoTime();
+        mNotifications.fetch_add(1, std::memory_order_relaxed);
+        int value = readValue();
+        if (value < 0) {
+            return;
+        }
+        if (isHalWrite(value, now)) {
+            // Arming or disarming the sensor, not a finger.
+            mLast = value;
+            mHalWrites.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        if (value == mLast) {
+            // The press was too short to see.
+            mUnchanged.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        mLast = value;
+        if (value) {
+            mPresses.fetch_add(1, std::memory_order_relaxed);
+            FP_TRACE_NAME("FpPressDown");
+            mHandler(true, now);
+        } else {
+            mReleases.fetch_add(1, std::memory_order_relaxed);
+            FP_TRACE_NAME("FpPressUp");
+            mHandler(false, now);
+        }
+    }
+}
+
+std::string FodPressWatcher::toString() const {
+    return ::android::base::StringPrintf(
+            "%s: notifications=%llu presses=%llu releases=%llu unchanged=%llu halWrites=%llu\n",
+            mPath.c_str(), static_cast<unsigned long long>(mNotifications.load()),
+            static_cast<unsigned long long>(mPresses.load()),
+            static_cast<unsigned long long>(mReleases.load()),
+            static_cast<unsigned long long>(mUnchanged.load()),
+            static_cast<unsigned long long>(mHalWrites.load()));
+}
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_TAG "FingerprintHalFod"
+
+#include "FodStateMachine.h"
+
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+
+#include "FingerprintTrace.h"
+#include "util/Util.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+namespace {
+
+constexpr const char* kStateNames[] = {"idle", "armed", "illuminated", "capturing", "done"};
+static_assert(std::size(kStateNames) == FodStateMachine::kStates);
+
+constexpr char kTraceFodState[] = "FpFodState";
+
+}  // namespace
+
+FodStateMachine::FodStateMachine(FodActuator* actuator)
+    : mActuator(actuator), mState(FodState::kIdle), mTransitions(0), mNoops(0) {}
+
+FodState FodStateMachine::dispatch(FodEvent event, int32_t x, int32_t y) {
+    std::lock_guard<std::mutex> lock(mLock);
+    FodState to = next(mState, event);
+    uint8_t changed = actions(mState, to);
+    if (to == mState || changed == 0) {
+        mState = to;
+        mNoops++;
+        return to;
+    }
+
+    uint8_t on = kStateOutputs[static_cast<size_t>(to)];
+    LOG(DEBUG) << kStateNames[static_cast<size_t>(mState)] << " -> "
+               << kStateNames[static_cast<size_t>(to)];
+    int64_t begin = Util::getSystemNanoTime();
+    if (changed & on & kFodStatus) {
+        mActuator->setFodStatus(true);
+        mWrites[0]++;
+    }
+    // The panel ramp is the long pole of a finger down, so it starts first and the coordinates
+    // go out meanwhile. The press status lets the vendor capture, it waits for the panel.
+    bool lighting = changed & on & kLocalHbm;
+    if (lighting) {
+        mActuator->beginLocalHbm();
+        mWrites[3]++;
+    }
+    if (changed & kCoordinates) {
+        bool set = on & kCoordinates;
+        mActuator->setPressCoordinates(set ? x : 0, set ? y : 0);
+        mWrites[1]++;
+    }
+    if (lighting) {
+        mArmTime.record(Util::getSystemNanoTime() - begin);
+        mActuator->finishLocalHbm();
+    }
+    if (changed & kPressStatus) {
+        mActuator->setPressStatus(on & kPressStatus);
+        mWrites[2]++;
+    }
+    // Released the other way round: the press is withdrawn before the panel goes dark.
+    if (changed & ~on & kLocalHbm) {
+        mActuator->cancelLocalHbm();
+        mActuator->setLocalHbm(false);
+        mWrites[3]++;
+    }
+    if (changed & ~on & kFodStatus) {
+        mActuator->setFodStatus(false);
+        mWrites[0]++;
+    }
+
+    if (lighting) {
+        mFingerDownTime.record(Util::getSystemNanoTime() - begin);
+    }
+    mState = to;
+    mTransitions++;
+    ATRACE_INT(kTraceFodState, static_cast<int32_t>(to));
+    return to;
+}
+
+FodState FodStateMachine::state() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mState;
+}
+
+std::string FodStateMachine::toString() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return ::android::base::StringPrintf(
+            "fod: state=%s transitions=%llu noops=%llu writes fod=%llu coords=%llu press=%llu "
+            "hbm=%llu\n  arm %s\n  finger down %s\n",
+            kStateNames[static_cast<size_t>(mState)], static_cast<unsigned long long>(mTransitions),
+            static_cast<unsigned long long>(mNoops), static_cast<unsigned long long>(mWrites[0]),
+            static_cast<unsigned long long>(mWrites[1]), static_cast<unsigned long long>(mWrites[2]),
+            static_cast<unsigned long long>(mWrites[3]), mArmTime.toString().c_str(),
+            mFingerDownTime.toString().c_str());
+}
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_TAG "FingerprintHalIllumination"
+
+#include "IlluminationThread.h"
+
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+
+#include "FingerprintTrace.h"
+#include "util/Util.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+IlluminationThread::IlluminationThread()
+    : mStartNs(0),
+      mStarted(0),
+      mFinished(0),
+      mIsDestructing(false),
+      mReplaced(0),
+      mCancelled(0),
+      mTimeouts(0),
+      mThread([this] { threadFunc(); }) {}
+
+IlluminationThread::~IlluminationThread() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mIsDestructing = true;
+    }
+    mCond.notify_all();
+    mThread.join();
+}
+
+void IlluminationThread::start(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mJob) {
+            mReplaced++;
+        } else {
+            mStarted++;
+        }
+        mJob = std::move(job);
+        // The new job decides what the panel ends up with.
+        mUndo = nullptr;
+        mStartNs = Util::getSystemNanoTime();
+    }
+    mCond.notify_all();
+}
+
+bool IlluminationThread::wait(int64_t timeoutMs) {
+    FP_TRACE_CALL();
+    int64_t begin = Util::getSystemNanoTime();
+    std::unique_lock<std::mutex> lock(mLock);
+    bool done = mCond.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                               [this] { return mFinished == mStarted; });
+    if (!done) {
+        mTimeouts++;
+        LOG(WARNING) << "Illumination did not finish within " << timeoutMs << "ms";
+    }
+    mWaitTime.record(Util::getSystemNanoTime() - begin);
+    return done;
+}
+
+bool IlluminationThread::cancel(int64_t timeoutMs, std::function<void()> undo) {
+    FP_TRACE_CALL();
+    std::unique_lock<std::mutex> lock(mLock);
+    if (mJob) {
+        // Accounted as finished, it will never run.
+        mJob = nullptr;
+        mFinished++;
+        mCancelled++;
+    }
+    if (mCond.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                       [this] { return mFinished == mStarted; })) {
+        return true;
+    }
+    mTimeouts++;
+    mUndo = std::move(undo);
+    LOG(ERROR) << "Illumination still running " << timeoutMs << "ms after cancel";
+    return false;
+}
+
+bool IlluminationThread::isUndoPending() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mUndo != nullptr;
+}
+
+void IlluminationThread::threadFunc() {
+    std::unique_lock<std::mutex> lock(mLock);
+    while (true) {
+        mCond.wait(lock, [this] { return mIsDestructing || mJob; });
+        if (mIsDestructing) {
+            return;
+        }
+        std::function<void()> job = std::move(mJob);
+        mJob = nullptr;
+        int64_t begin = Util::getSystemNanoTime();
+        mWakeup.record(begin - mStartNs);
+        lock.unlock();
+        {
+            FP_TRACE_NAME("FpIllumination");
+            job();
+        }
+        mRunTime.record(Util::getSystemNanoTime() - begin);
+        lock.lock();
+        mFinished++;
+        mCond.notify_all();
+
+        if (std::function<void()> undo = std::move(mUndo)) {
+            mUndo = nullptr;
+            lock.unlock();
+            undo();
+            lock.lock();
+        }
+    }
+}
+
+std::string IlluminationThread::toString() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return ::android::base::StringPrintf(
+            "illumination: jobs=%llu replaced=%llu cancelled=%llu timeouts=%llu\n  wakeup %s\n"
+            "  run %s\n  barrier %s\n",
+            static_cast<unsigned long long>(mFinished - mCancelled),
+            static_cast<unsigned long long>(mReplaced), static_cast<unsigned long long>(mCancelled),
+            static_cast<unsigned long long>(mTimeouts), mWakeup.toString().c_str(),
+            mRunTime.toString().c_str(), mWaitTime.toString().c_str());
+}
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
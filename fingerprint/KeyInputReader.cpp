@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_TAG "FingerprintHalKey"
+
+#include "KeyInputReader.h"
+
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+
+#include <fcntl.h>
+#include <linux/input.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <ctime>
+#include <iterator>
+
+#include "FingerprintTrace.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+namespace {
+
+constexpr size_t kReadBatch = 16;
+
+int64_t eventTimeNs(const input_event& event) {
+    return static_cast<int64_t>(event.input_event_sec) * 1000000000LL +
+           static_cast<int64_t>(event.input_event_usec) * 1000LL;
+}
+
+}  // namespace
+
+KeyInputReader::KeyInputReader(uint16_t code, Handler onPress)
+    : mCode(code), mOnPress(std::move(onPress)) {}
+
+KeyInputReader::~KeyInputReader() {
+    if (mThread.joinable()) {
+        uint64_t one = 1;
+        TEMP_FAILURE_RETRY(write(mStopFd.get(), &one, sizeof(one)));
+        mThread.join();
+    }
+}
+
+bool KeyInputReader::start(const std::string& path) {
+    mPath = path;
+    mInputFd.reset(TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC)));
+    if (!mInputFd.ok()) {
+        PLOG(ERROR) << "Failed to open " << path;
+        return false;
+    }
+    // Same clock as Util::getSystemNanoTime(), so event times can be compared with ours.
+    int clock = CLOCK_MONOTONIC;
+    if (ioctl(mInputFd.get(), EVIOCSCLOCKID, &clock) != 0) {
+        PLOG(WARNING) << "Failed to switch " << path << " to CLOCK_MONOTONIC";
+    }
+
+    mEpollFd.reset(epoll_create1(EPOLL_CLOEXEC));
+    mStopFd.reset(eventfd(0, EFD_CLOEXEC));
+    if (!mEpollFd.ok() || !mStopFd.ok()) {
+        PLOG(ERROR) << "Failed to create epoll/eventfd";
+        return false;
+    }
+    epoll_event input = {.events = EPOLLIN, .data = {.fd = mInputFd.get()}};
+    epoll_event stop = {.events = EPOLLIN, .data = {.fd = mStopFd.get()}};
+    if (epoll_ctl(mEpollFd.get(), EPOLL_CTL_ADD, mInputFd.get(), &input) != 0 ||
+        epoll_ctl(mEpollFd.get(), EPOLL_CTL_ADD, mStopFd.get(), &stop) != 0) {
+        PLOG(ERROR) << "Failed to watch " << path;
+        return false;
+    }
+
+    mThread = std::thread([this] { threadFunc(); });
+    LOG(INFO) << "Reading key " << mCode << " from " << path;
+    return true;
+}
+
+void KeyInputReader::threadFunc() {
+    input_event events[kReadBatch];
+    epoll_event ready[2];
+
+    while (true) {
+        int count = TEMP_FAILURE_RETRY(epoll_wait(mEpollFd.get(), ready, std::size(ready), -1));
+        if (count < 0) {
+            PLOG(ERROR) << "epoll_wait failed";
+            return;
+        }
+        for (int i = 0; i < count; i++) {
+            if (ready[i].data.fd == mStopFd.get()) {
+                return;
+            }
+        }
+
+        ssize_t size;
+        while ((size = TEMP_FAILURE_RETRY(read(mInputFd.get(), events, sizeof(events)))) > 0) {
+            size_t n = size / sizeof(input_event);
+            for (size_t i = 0; i < n; i++) {
+                // Only the press: a wake is decided on key down, repeats and releases don't
+                // matter here.
+                if (events[i].type == EV_KEY && events[i].code == mCode && events[i].value == 1) {
+                    mPresses.fetch_add(1, std::memory_order_relaxed);
+                    FP_TRACE_NAME("FpKeyDown");
+                    mOnPress(eventTimeNs(events[i]));
+                }
+            }
+        }
+        if (size == 0 || (size < 0 && errno != EAGAIN)) {
+            PLOG(ERROR) << "Lost " << mPath;
+            return;
+        }
+    }
+}
+
+std::string KeyInputReader::toString() const {
+    return ::android::base::StringPrintf("%s: key=%u presses=%llu\n", mPath.c_str(), mCode,
+                                         static_cast<unsigned long long>(mPresses.load()));
+}
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
@@ -24,16 +24,19 @@ using namespace ::android::fingerprint::peridot;
 namespace aidl::android::hardware::biometrics::fingerprint {
 
 void LockoutTracker::reset(bool dueToTimeout) {
-    LOG(INFO) << __func__;
+    LOG(DEBUG) << __func__;
+    std::lock_guard<std::mutex> lock(mLock);
     if (!dueToTimeout) {
         mFailedCount = 0;
     }
     mLockoutTimedStart = 0;
     mCurrentMode = LockoutMode::kNone;
+    persistLocked();
 }
 
 void LockoutTracker::addFailedAttempt() {
-    LOG(INFO) << __func__;
+    LOG(DEBUG) << __func__;
+    std::lock_guard<std::mutex> lock(mLock);
     mFailedCount++;
     if (mFailedCount >= LOCKOUT_PERMANENT_THRESHOLD) {
         mCurrentMode = LockoutMode::kPermanent;
@@ -43,9 +46,35 @@ void LockoutTracker::addFailedAttempt() {
             mLockoutTimedStart = Util::getSystemNanoTime();
         }
     }
+    persistLocked();
+}
+
+void LockoutTracker::attach(StateSnapshot* snapshot) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mSnapshot = snapshot;
+    // Boot-scoped, so the timestamp is on the same CLOCK_MONOTONIC.
+    PersistentState state = snapshot->state();
+    mFailedCount = state.lockout.failedCount;
+    mCurrentMode = static_cast<LockoutMode>(state.lockout.mode);
+    mLockoutTimedStart = state.lockout.timedStartNs;
+    if (mFailedCount != 0) {
+        LOG(INFO) << "Restored " << mFailedCount << " failed attempts";
+    }
+}
+
+void LockoutTracker::persistLocked() {
+    if (mSnapshot == nullptr) {
+        return;
+    }
+    mSnapshot->update([this](PersistentState* state) {
+        state->lockout.failedCount = mFailedCount;
+        state->lockout.mode = static_cast<int8_t>(mCurrentMode);
+        state->lockout.timedStartNs = mLockoutTimedStart;
+    });
 }
 
 LockoutTracker::LockoutMode LockoutTracker::getMode() {
+    std::lock_guard<std::mutex> lock(mLock);
     if (mCurrentMode == LockoutMode::kTimed) {
         if (Util::hasElapsed(mLockoutTimedStart, LOCKOUT_TIMED_DURATION)) {
             mCurrentMode = LockoutMode::kNone;
@@ -57,13 +86,14 @@ LockoutTracker::LockoutMode LockoutTracker::getMode() {
 }
 
 int64_t LockoutTracker::getLockoutTimeLeft() {
+    std::lock_guard<std::mutex> lock(mLock);
     int64_t res = 0;
 
     if (mLockoutTimedStart > 0) {
         auto now = Util::getSystemNanoTime();
         auto elapsed = (now - mLockoutTimedStart) / 1000000LL;
         res = LOCKOUT_TIMED_DURATION - elapsed;
-        LOG(INFO) << "elapsed=" << elapsed << " now = " << now
+        LOG(DEBUG) << "elapsed=" << elapsed << " now = " << now
                   << " mLockoutTimedStart=" << mLockoutTimedStart << " res=" << res;
     }
 
@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_TAG "FingerprintHalNotify"
+
+#include "NotifyDispatcher.h"
+
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+NotifyDispatcher::NotifyDispatcher(Handler handler)
+    : mHandler(std::move(handler)), mEventFd(eventfd(0, EFD_CLOEXEC)) {
+    CHECK(mEventFd.ok()) << "Failed to create eventfd";
+    for (size_t i = 0; i < kCapacity; i++) {
+        mRing[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    mThread = std::thread([this] { threadFunc(); });
+}
+
+NotifyDispatcher::~NotifyDispatcher() {
+    mStop = true;
+    wake();
+    mThread.join();
+}
+
+void NotifyDispatcher::wake() {
+    uint64_t one = 1;
+    // eventfd writes never block unless the counter saturates, which cannot happen here.
+    TEMP_FAILURE_RETRY(write(mEventFd.get(), &one, sizeof(one)));
+}
+
+bool NotifyDispatcher::isLossless(const fingerprint_msg_t& msg) {
+    if (msg.type != FINGERPRINT_ACQUIRED) {
+        return true;
+    }
+    // Standard codes and the vendor codes below drive the FOD state machine.
+    int32_t code = msg.data.acquired.acquired_info;
+    if (code <= FINGERPRINT_ACQUIRED_VENDOR_BASE) {
+        return true;
+    }
+    code -= FINGERPRINT_ACQUIRED_VENDOR_BASE;
+    return code == FINGERPRINT_ACQUIRED_VENDOR_WAITING_AUTHENTICATE ||
+           code == FINGERPRINT_ACQUIRED_VENDOR_WAITING_ENROLL ||
+           code == FINGERPRINT_ACQUIRED_VENDOR_SCAN_FAILED;
+}
+
+bool NotifyDispatcher::isCurrent(uint32_t generation) const {
+    return generation == kAnyGeneration ||
+           generation == mGeneration.load(std::memory_order_acquire);
+}
+
+void NotifyDispatcher::post(const fingerprint_msg_t* msg, uint32_t generation) {
+    if (!isCurrent(generation)) {
+        mStale.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    push(*msg, generation);
+}
+
+void NotifyDispatcher::inject(const fingerprint_msg_t& msg) {
+    push(msg, kAnyGeneration);
+}
+
+uint32_t NotifyDispatcher::nextGeneration() {
+    uint32_t generation = mGeneration.fetch_add(1, std::memory_order_acq_rel) + 1;
+    // Nothing would tell the next device from one that hung before.
+    CHECK_LT(generation, kGenerations) << "Opened too many vendor devices";
+    return generation;
+}
+
+void NotifyDispatcher::push(const fingerprint_msg_t& msg, uint32_t generation) {
+    mPosted.fetch_add(1, std::memory_order_relaxed);
+    Entry entry = {msg, generation};
+    bool lossless = isLossless(msg);
+
+    if (!mSpillPending.load(std::memory_order_acquire) && tryPush(entry, lossless)) {
+        wake();
+        return;
+    }
+    if (!lossless) {
+        mDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mSpillLock);
+        mSpill.push_back(entry);
+        mSpillPending.store(true, std::memory_order_release);
+    }
+    mSpilled.fetch_add(1, std::memory_order_relaxed);
+    wake();
+}
+
+bool NotifyDispatcher::tryPush(const Entry& entry, bool lossless) {
+    size_t limit = lossless ? kCapacity : kCapacity - kReserved;
+    size_t pos = mTail.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+        if (pos - mHead.load(std::memory_order_acquire) >= limit) {
+            return false;
+        }
+        slot = &mRing[pos & (kCapacity - 1)];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<ptrdiff_t>(sequence - pos);
+        if (diff == 0) {
+            if (mTail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Not consumed yet since the last lap.
+            return false;
+        } else {
+            pos = mTail.load(std::memory_order_relaxed);
+        }
+    }
+    slot->entry = entry;
+    slot->sequence.store(pos + 1, std::memory_order_release);
+
+    size_t depth = pos + 1 - mHead.load(std::memory_order_relaxed);
+    size_t highWater = mHighWater.load(std::memory_order_relaxed);
+    while (depth > highWater &&
+           !mHighWater.compare_exchange_weak(highWater, depth, std::memory_order_relaxed)) {
+    }
+    return true;
+}
+
+void NotifyDispatcher::deliver(const Entry& entry) {
+    // A device replaced while its message was queued.
+    if (!isCurrent(entry.generation)) {
+        mStale.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    mHandler(entry.msg);
+}
+
+void NotifyDispatcher::threadFunc() {
+    // Shows up in traces, and tells the thread apart in tests.
+    pthread_setname_np(pthread_self(), "FpNotify");
+    std::deque<Entry> spilled;
+    while (true) {
+        uint64_t count;
+        if (TEMP_FAILURE_RETRY(read(mEventFd.get(), &count, sizeof(count))) < 0) {
+            PLOG(ERROR) << "Failed to read eventfd";
+            return;
+        }
+        if (mStop) {
+            return;
+        }
+
+        drainRing();
+
+        if (mSpillPending.load(std::memory_order_acquire)) {
+            {
+                std::lock_guard<std::mutex> lock(mSpillLock);
+                spilled.swap(mSpill);
+                mSpillPending.store(false, std::memory_order_release);
+            }
+            // A producer may have published to the ring after the drain above and then spilled
+            // its next message: those ring entries come first. Nothing new goes to the ring while
+            // the spill list is pending, so the rest of the ring is newer than the spilled ones.
+            drainRing();
+            for (const auto& entry : spilled) {
+                deliver(entry);
+            }
+            spilled.clear();
+        }
+    }
+}
+
+void NotifyDispatcher::drainRing() {
+    // Stops at the first slot claimed but not published yet, its producer wakes us once it is.
+    size_t head = mHead.load(std::memory_order_relaxed);
+    while (true) {
+        Slot& slot = mRing[head & (kCapacity - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != head + 1) {
+            return;
+        }
+        Entry entry = slot.entry;
+        slot.sequence.store(head + kCapacity, std::memory_order_release);
+        mHead.store(++head, std::memory_order_release);
+        deliver(entry);
+    }
+}
+
+std::string NotifyDispatcher::toString() const {
+    return ::android::base::StringPrintf(
+            "----- Vendor notify -----\n"
+            "posted=%llu dropped=%llu spilled=%llu stale=%llu highWater=%zu/%zu\n",
+            static_cast<unsigned long long>(mPosted.load()),
+            static_cast<unsigned long long>(mDropped.load()),
+            static_cast<unsigned long long>(mSpilled.load()),
+            static_cast<unsigned long long>(mStale.load()), mHighWater.load(), kCapacity);
+}
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
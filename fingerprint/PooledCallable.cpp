@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_TAG "FingerprintHalPool"
+
+#include "PooledCallable.h"
+
+#include <android-base/stringprintf.h>
+
+#include <new>
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+CallablePool::Block CallablePool::sBlocks[kBlocks];
+std::atomic<uint32_t> CallablePool::sFree{kBlocks == 32 ? UINT32_MAX : (1u << kBlocks) - 1};
+std::atomic<uint64_t> CallablePool::sPooled{0};
+std::atomic<uint64_t> CallablePool::sMisses{0};
+
+void* CallablePool::allocate(size_t size) {
+    if (size <= kBlockSize) {
+        uint32_t free = sFree.load(std::memory_order_relaxed);
+        while (free != 0) {
+            uint32_t taken = free & -free;
+            if (sFree.compare_exchange_weak(free, free & ~taken, std::memory_order_acquire,
+                                            std::memory_order_relaxed)) {
+                sPooled.fetch_add(1, std::memory_order_relaxed);
+                return &sBlocks[__builtin_ctz(taken)];
+            }
+        }
+    }
+    sMisses.fetch_add(1, std::memory_order_relaxed);
+    return ::operator new(size);
+}
+
+void CallablePool::release(void* block) {
+    auto* pooled = static_cast<Block*>(block);
+    if (pooled < std::begin(sBlocks) || pooled >= std::end(sBlocks)) {
+        ::operator delete(block);
+        return;
+    }
+    sFree.fetch_or(1u << (pooled - sBlocks), std::memory_order_release);
+}
+
+std::string CallablePool::toString() {
+    return ::android::base::StringPrintf(
+            "callablePool: pooled=%llu misses=%llu free=%d/%zu\n",
+            static_cast<unsigned long long>(sPooled.load()),
+            static_cast<unsigned long long>(sMisses.load()),
+            __builtin_popcount(sFree.load()), kBlocks);
+}
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_TAG "FingerprintHalBoost"
+
+#include "SchedBoost.h"
+
+#include <android-base/logging.h>
+#include <android-base/parseint.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+
+#include <dirent.h>
+#include <linux/sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "FingerprintTrace.h"
+#include "util/Util.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+namespace {
+
+constexpr char kTaskPath[] = "/proc/self/task";
+constexpr char kTraceBoost[] = "FpBoost";
+
+// struct sched_attr of the kernel (SCHED_ATTR_SIZE_VER1), libc does not export it.
+struct SchedAttr {
+    uint32_t size;
+    uint32_t sched_policy;
+    uint64_t sched_flags;
+    int32_t sched_nice;
+    uint32_t sched_priority;
+    uint64_t sched_runtime;
+    uint64_t sched_deadline;
+    uint64_t sched_period;
+    uint32_t sched_util_min;
+    uint32_t sched_util_max;
+};
+
+bool getUclampMin(pid_t tid, uint32_t* value) {
+    SchedAttr attr = {};
+    if (syscall(SYS_sched_getattr, tid, &attr, sizeof(attr), 0) != 0) return false;
+    *value = attr.sched_util_min;
+    return true;
+}
+
+bool setUclampMin(pid_t tid, uint32_t value) {
+    SchedAttr attr = {};
+    attr.size = sizeof(attr);
+    attr.sched_flags = SCHED_FLAG_KEEP_ALL | SCHED_FLAG_UTIL_CLAMP_MIN;
+    attr.sched_util_min = value;
+    return syscall(SYS_sched_setattr, tid, &attr, 0) == 0;
+}
+
+std::vector<pid_t> listThreads() {
+    std::vector<pid_t> tids;
+    DIR* dir = opendir(kTaskPath);
+    if (dir == nullptr) {
+        PLOG(ERROR) << "Failed to list " << kTaskPath;
+        return tids;
+    }
+    while (dirent* entry = readdir(dir)) {
+        pid_t tid;
+        if (::android::base::ParseInt(entry->d_name, &tid)) tids.push_back(tid);
+    }
+    closedir(dir);
+    return tids;
+}
+
+}  // namespace
+
+bool SchedBoost::parseCpus(const std::string& cpus, cpu_set_t* out) {
+    CPU_ZERO(out);
+    for (const auto& range : ::android::base::Split(cpus, ",")) {
+        auto bounds = ::android::base::Split(range, "-");
+        int first, last;
+        if (bounds.size() > 2 || !::android::base::ParseInt(bounds.front(), &first, 0) ||
+            !::android::base::ParseInt(bounds.back(), &last, first, CPU_SETSIZE - 1)) {
+            return false;
+        }
+        for (int cpu = first; cpu <= last; cpu++) CPU_SET(cpu, out);
+    }
+    return CPU_COUNT(out) > 0;
+}
+
+bool SchedBoost::begin(const Policy& policy) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mActive || !policy.enabled()) {
+        return false;
+    }
+    FP_TRACE_CALL();
+
+    cpu_set_t target;
+    bool moveThreads = !policy.cpus.empty();
+    if (moveThreads && !parseCpus(policy.cpus, &target)) {
+        LOG(ERROR) << "Invalid boost CPU list: " << policy.cpus;
+        moveThreads = false;
+        mErrors++;
+    }
+
+    for (pid_t tid : listThreads()) {
+        SavedThread saved = {.tid = tid, .uclamp = false, .utilMin = 0, .affinity = false};
+        if (policy.uclampMin > 0) {
+            if (!getUclampMin(tid, &saved.utilMin)) {
+                mErrors++;
+            } else if (saved.utilMin < static_cast<uint32_t>(policy.uclampMin)) {
+                // A thread already asking for more, like one boosted by the framework, keeps it.
+                saved.uclamp = setUclampMin(tid, policy.uclampMin);
+                if (!saved.uclamp) mErrors++;
+            }
+        }
+        if (moveThreads && sched_getaffinity(tid, sizeof(saved.mask), &saved.mask) == 0) {
+            saved.affinity = sched_setaffinity(tid, sizeof(target), &target) == 0;
+            if (!saved.affinity) mErrors++;
+        }
+        if (saved.uclamp || saved.affinity) mSaved.push_back(saved);
+    }
+    if (mSaved.empty()) {
+        LOG(WARNING) << "Failed to boost any thread, errors=" << mErrors;
+        return false;
+    }
+
+    mActive = true;
+    mStartNs = Util::getSystemNanoTime();
+    mBoosts++;
+    mThreads += mSaved.size();
+    ATRACE_INT(kTraceBoost, 1);
+    return true;
+}
+
+void SchedBoost::end() {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (!mActive) {
+        return;
+    }
+    FP_TRACE_CALL();
+    // Threads that exited in the meantime fail with ESRCH, which is fine.
+    for (const SavedThread& saved : mSaved) {
+        if (saved.uclamp) setUclampMin(saved.tid, saved.utilMin);
+        if (saved.affinity) sched_setaffinity(saved.tid, sizeof(saved.mask), &saved.mask);
+    }
+    mSaved.clear();
+    mActive = false;
+    mDuration.record(Util::getSystemNanoTime() - mStartNs);
+    ATRACE_INT(kTraceBoost, 0);
+}
+
+bool SchedBoost::active() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mActive;
+}
+
+std::string SchedBoost::toString() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return ::android::base::StringPrintf(
+            "boost: %s boosts=%llu threads=%llu errors=%llu duration %s\n",
+            mActive ? "active" : "idle", static_cast<unsigned long long>(mBoosts),
+            static_cast<unsigned long long>(mThreads), static_cast<unsigned long long>(mErrors),
+            mDuration.toString().c_str());
+}
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
@@ -16,8 +16,15 @@
 
 #include "Session.h"
 
+#include <aidl/android/hardware/biometrics/common/BnCancellationSignal.h>
 #include <android-base/logging.h>
+#include <log/log.h>
 
+#include <cinttypes>
+#include <functional>
+#include <mutex>
+
+#include "FingerprintTrace.h"
 #include "util/CancellationSignal.h"
 
 #undef LOG_TAG
@@ -25,6 +32,31 @@
 
 namespace aidl::android::hardware::biometrics::fingerprint {
 
+namespace {
+
+// Besides completing the future checked by the queued task, reaches the engine right away so an
+// operation that is already running in the vendor device gets cancelled too.
+class OperationCancellationSignal : public common::BnCancellationSignal {
+  public:
+    OperationCancellationSignal(std::promise<void>&& promise, std::function<void()> onCancel)
+        : mPromise(std::move(promise)), mOnCancel(std::move(onCancel)) {}
+
+    ndk::ScopedAStatus cancel() override {
+        std::call_once(mCancelled, [this] {
+            mPromise.set_value();
+            mOnCancel();
+        });
+        return ndk::ScopedAStatus::ok();
+    }
+
+  private:
+    std::promise<void> mPromise;
+    std::function<void()> mOnCancel;
+    std::once_flag mCancelled;
+};
+
+}  // namespace
+
 void onClientDeath(void* cookie) {
     LOG(INFO) << "FingerprintService has died";
     Session* session = static_cast<Session*>(cookie);
@@ -34,20 +66,45 @@ void onClientDeath(void* cookie) {
 }
 
 Session::Session(int sensorId, int userId, std::shared_ptr<ISessionCallback> cb,
-                 FingerprintEngine* engine, WorkerThread* worker)
+                 Engine* engine, WorkScheduler* worker)
     : mSensorId(sensorId),
       mUserId(userId),
-      mCb(std::move(cb)),
+      mCb(mCallbacks.wrap(cb)),
       mEngine(engine),
-      mWorker(worker) {
+      mWorker(worker),
+      mIsClosed(false),
+      mRejectedPointerId(kNoPointer) {
     CHECK_GE(mSensorId, 0);
     CHECK_GE(mUserId, 0);
     CHECK(mEngine);
     CHECK(mWorker);
-    CHECK(mCb);
+    CHECK(cb);
 
     mDeathRecipient = AIBinder_DeathRecipient_new(onClientDeath);
-    mEngine->setActiveGroup(mUserId);
+    mAuthToken.mac.reserve(sizeof(hw_auth_token_t::hmac));
+    // Loading the templates waits for /data and calls into the device, so it goes to the worker
+    // ahead of anything the new client asks for, not the binder thread holding the session lock.
+    mWorker->schedule(Callable::from([this] { mEngine->setActiveGroup(mUserId); }));
+}
+
+void Session::reopen(std::shared_ptr<ISessionCallback> cb) {
+    CHECK(mIsClosed) << "Reopening a session that is still open";
+    CHECK(cb);
+
+    std::shared_ptr<ISessionCallback> wrapped = mCallbacks.wrap(std::move(cb));
+    {
+        std::lock_guard<std::mutex> lock(mCbLock);
+        mCb.swap(wrapped);
+    }
+    mDeathRecipient = AIBinder_DeathRecipient_new(onClientDeath);
+    mWorker->schedule(Callable::from([this] { mEngine->setActiveGroup(mUserId); }));
+    mAggregator.reset();
+    mIsClosed = false;
+}
+
+std::shared_ptr<ISessionCallback> Session::callback() const {
+    std::lock_guard<std::mutex> lock(mCbLock);
+    return mCb;
 }
 
 binder_status_t Session::linkToDeath(AIBinder* binder) {
@@ -59,163 +116,190 @@ bool Session::isClosed() {
 }
 
 ndk::ScopedAStatus Session::generateChallenge() {
-    LOG(INFO) << "generateChallenge";
+    FP_TRACE_CALL();
+    LOG(DEBUG) << "generateChallenge";
 
     mWorker->schedule(Callable::from([this] {
-        mEngine->generateChallengeImpl(mCb.get());
+        mEngine->generateChallengeImpl(callback().get());
     }));
 
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Session::revokeChallenge(int64_t challenge) {
-    LOG(INFO) << "revokeChallenge";
+    FP_TRACE_CALL();
+    LOG(DEBUG) << "revokeChallenge";
 
     mWorker->schedule(Callable::from([this, challenge] {
-        mEngine->revokeChallengeImpl(mCb.get(), challenge);
+        mEngine->revokeChallengeImpl(callback().get(), challenge);
     }));
 
     return ndk::ScopedAStatus::ok();
 }
 
-ndk::ScopedAStatus Session::enroll(const keymaster::HardwareAuthToken& hat,
-                                   std::shared_ptr<common::ICancellationSignal>* out) {
-    LOG(INFO) << "enroll";
-
-    std::promise<void> cancellationPromise;
-    auto cancFuture = cancellationPromise.get_future();
+std::shared_ptr<common::ICancellationSignal> Session::scheduleOperation(
+        const char* name, std::function<void(const std::future<void>&)> start) {
+    std::promise<void> cancPromise;
+    auto cancFuture = cancPromise.get_future();
+    uint64_t op = mEngine->queueOperation(name);
 
-    mWorker->schedule(Callable::from([this, hat, cancFuture = std::move(cancFuture)] {
+    mWorker->schedule(Callable::from([this, op, start = std::move(start),
+                                      cancFuture = std::move(cancFuture)] {
+        if (!mEngine->startOperation(op)) {
+            return;
+        }
         if (shouldCancel(cancFuture)) {
-            mCb->onError(Error::CANCELED, 0 /* vendorCode */);
+            mEngine->onOperationFinished();
+            callback()->onError(Error::CANCELED, 0 /* vendorCode */);
         } else {
-            mEngine->enrollImpl(mCb.get(), hat, cancFuture);
+            start(cancFuture);
         }
     }));
 
-    *out = SharedRefBase::make<CancellationSignal>(std::move(cancellationPromise));
+    return SharedRefBase::make<OperationCancellationSignal>(std::move(cancPromise), [this, op] {
+        mWorker->schedule(WorkScheduler::TaskKind::kCancel, Callable::from([this, op] {
+            mEngine->cancelOperation(op);
+        }));
+    });
+}
+
+ndk::ScopedAStatus Session::enroll(const keymaster::HardwareAuthToken& hat,
+                                   std::shared_ptr<common::ICancellationSignal>* out) {
+    FP_TRACE_CALL();
+    LOG(DEBUG) << "enroll";
+
+    *out = scheduleOperation("FpEnroll", [this, hat](const std::future<void>& cancel) {
+        mEngine->enrollImpl(callback().get(), hat, cancel);
+    });
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Session::authenticate(int64_t operationId,
                                          std::shared_ptr<common::ICancellationSignal>* out) {
-    LOG(INFO) << "authenticate";
+    FP_TRACE_CALL();
+    LOG(DEBUG) << "authenticate";
 
-    std::promise<void> cancPromise;
-    auto cancFuture = cancPromise.get_future();
-
-    mWorker->schedule(Callable::from([this, operationId, cancFuture = std::move(cancFuture)] {
-        if (shouldCancel(cancFuture)) {
-            mCb->onError(Error::CANCELED, 0 /* vendorCode */);
-        } else {
-            mEngine->authenticateImpl(mCb.get(), operationId, cancFuture);
-        }
-    }));
-
-    *out = SharedRefBase::make<CancellationSignal>(std::move(cancPromise));
+    *out = scheduleOperation("FpAuthenticate", [this, operationId](const std::future<void>& cancel) {
+        mEngine->authenticateImpl(callback().get(), operationId, cancel);
+    });
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Session::detectInteraction(std::shared_ptr<common::ICancellationSignal>* out) {
-    LOG(INFO) << "detectInteraction";
-
-    std::promise<void> cancellationPromise;
-    auto cancFuture = cancellationPromise.get_future();
-
-    mWorker->schedule(Callable::from([this, cancFuture = std::move(cancFuture)] {
-        if (shouldCancel(cancFuture)) {
-            mCb->onError(Error::CANCELED, 0 /* vendorCode */);
-        } else {
-            mEngine->detectInteractionImpl(mCb.get(), cancFuture);
-        }
-    }));
+    FP_TRACE_CALL();
+    LOG(DEBUG) << "detectInteraction";
 
-    *out = SharedRefBase::make<CancellationSignal>(std::move(cancellationPromise));
+    *out = scheduleOperation("FpDetectInteraction", [this](const std::future<void>& cancel) {
+        mEngine->detectInteractionImpl(callback().get(), cancel);
+    });
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Session::enumerateEnrollments() {
-    LOG(INFO) << "enumerateEnrollments";
+    FP_TRACE_CALL();
+    LOG(DEBUG) << "enumerateEnrollments";
 
     mWorker->schedule(Callable::from([this] {
-        mEngine->enumerateEnrollmentsImpl(mCb.get());
+        mEngine->enumerateEnrollmentsImpl(callback().get());
     }));
 
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Session::removeEnrollments(const std::vector<int32_t>& enrollmentIds) {
-    LOG(INFO) << "removeEnrollments, size:" << enrollmentIds.size();
+    FP_TRACE_CALL();
+    LOG(DEBUG) << "removeEnrollments, size:" << enrollmentIds.size();
 
     mWorker->schedule(Callable::from([this, enrollmentIds] {
-        mEngine->removeEnrollmentsImpl(mCb.get(), enrollmentIds);
+        mEngine->removeEnrollmentsImpl(callback().get(), enrollmentIds);
     }));
 
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Session::getAuthenticatorId() {
-    LOG(INFO) << "getAuthenticatorId";
+    FP_TRACE_CALL();
+    LOG(DEBUG) << "getAuthenticatorId";
 
     mWorker->schedule(Callable::from([this] {
-        mEngine->getAuthenticatorIdImpl(mCb.get());
+        mEngine->getAuthenticatorIdImpl(callback().get());
     }));
 
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Session::invalidateAuthenticatorId() {
-    LOG(INFO) << "invalidateAuthenticatorId";
+    FP_TRACE_CALL();
+    LOG(DEBUG) << "invalidateAuthenticatorId";
 
     mWorker->schedule(Callable::from([this] {
-        mEngine->invalidateAuthenticatorIdImpl(mCb.get());
+        mEngine->invalidateAuthenticatorIdImpl(callback().get());
     }));
 
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Session::resetLockout(const keymaster::HardwareAuthToken& hat) {
-    LOG(INFO) << "resetLockout";
+    FP_TRACE_CALL();
+    LOG(DEBUG) << "resetLockout";
 
     mWorker->schedule(Callable::from([this, hat] {
-        mEngine->resetLockoutImpl(mCb.get(), hat);
+        mEngine->resetLockoutImpl(callback().get(), hat);
     }));
 
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Session::close() {
+    FP_TRACE_CALL();
     LOG(INFO) << "close";
     // TODO(b/166800618): call enterIdling from the terminal callbacks and restore this check.
     // CHECK(mCurrentState == SessionState::IDLING) << "Can't close a non-idling session.
     // Crashing.";
     mIsClosed = true;
-    mCb->onSessionClosed();
+    mEngine->onSessionClosed();
+    callback()->onSessionClosed();
     AIBinder_DeathRecipient_delete(mDeathRecipient);
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Session::onPointerDown(int32_t pointerId, int32_t x, int32_t y, float minor,
                                           float major) {
-    LOG(INFO) << "onPointerDown";
-    mWorker->schedule(Callable::from([this, pointerId, x, y, minor, major] {
-        bool isLockout = mEngine->checkSensorLockout(mCb.get());
-        if (!isLockout) mEngine->onPointerDownImpl(pointerId, x, y, minor, major);
-    }));
+    FP_TRACE_CALL();
+    LOG(DEBUG) << "onPointerDown";
+    if (!mEngine->acceptTouch(x, y, minor, major)) {
+        // Not a finger on the sensor: leave the panel and the sensor alone, including for the
+        // matching pointer up.
+        mRejectedPointerId = pointerId;
+        return ndk::ScopedAStatus::ok();
+    }
+    mEngine->beginUnlock();
+    mWorker->schedule(WorkScheduler::TaskKind::kPointerDown,
+                      Callable::from([this, pointerId, x, y, minor, major] {
+                          bool isLockout = mEngine->checkSensorLockout(callback().get());
+                          if (!isLockout) mEngine->onPointerDownImpl(pointerId, x, y, minor, major);
+                      }),
+                      pointerId);
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Session::onPointerUp(int32_t pointerId) {
-    LOG(INFO) << "onPointerUp";
-    mWorker->schedule(Callable::from([this, pointerId] {
+    FP_TRACE_CALL();
+    LOG(DEBUG) << "onPointerUp";
+    int32_t rejected = pointerId;
+    if (mRejectedPointerId.compare_exchange_strong(rejected, kNoPointer)) {
+        return ndk::ScopedAStatus::ok();
+    }
+    mWorker->schedule(WorkScheduler::TaskKind::kPointerUp, Callable::from([this, pointerId] {
         mEngine->onPointerUpImpl(pointerId);
-    }));
+    }), pointerId);
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Session::onUiReady() {
-    LOG(INFO) << "onUiReady";
-    mWorker->schedule(Callable::from([this] {
+    FP_TRACE_CALL();
+    LOG(DEBUG) << "onUiReady";
+    mWorker->schedule(WorkScheduler::TaskKind::kUiReady, Callable::from([this] {
         mEngine->onUiReadyImpl();
     }));
     return ndk::ScopedAStatus::ok();
@@ -259,88 +343,117 @@ ndk::ScopedAStatus Session::setIgnoreDisplayTouches(bool /*shouldIgnore*/) {
     return ndk::ScopedAStatus::ok();
 }
 
+// Runs for every vendor message, so it logs with printf-style ALOG rather than building streams.
 void Session::notify(const fingerprint_msg_t* msg) {
+    FP_TRACE_NAME(traceName(msg->type));
     // const uint64_t devId = reinterpret_cast<uint64_t>(mDevice);
+    const std::shared_ptr<ISessionCallback> cb = callback();
+    if (msg->type != FINGERPRINT_ACQUIRED) mAggregator.endAcquired();
     switch (msg->type) {
         case FINGERPRINT_ERROR: {
             std::pair<Error, int32_t> result = mEngine->convertError(msg->data.error);
-            LOG(INFO) << "onError(" << static_cast<int>(result.first) << ", " << result.second << ")";
-            mCb->onError(result.first, result.second);
+            if (result.first == Error::CANCELED && mEngine->consumeOperationTimeout()) {
+                result.first = Error::TIMEOUT;
+            }
+            mEngine->onOperationFinished();
+            if (mAggregator.abort(&mEnrollments)) {
+                // These are gone from the vendor database even though the removal failed.
+                mEngine->onEnrollmentsChanged();
+                cb->onEnrollmentsRemoved(mEnrollments);
+            }
+            ALOGI("onError(%d, %d)", static_cast<int>(result.first), result.second);
+            cb->onError(result.first, result.second);
         } break;
         case FINGERPRINT_ACQUIRED: {
             std::pair<AcquiredInfo, int32_t> result =
                     mEngine->convertAcquiredInfo(msg->data.acquired.acquired_info);
-            LOG(INFO) << "onAcquired(" << static_cast<int>(result.first) << ", " << result.second << ")";
+            ALOGD("onAcquired(%d, %d)", static_cast<int>(result.first), result.second);
+            mEngine->mMetrics.mark(FingerprintMetrics::Stage::kFirstAcquired);
             mEngine->onAcquired(static_cast<int32_t>(result.first), result.second);
             // don't process vendor messages further since frameworks try to disable
             // udfps display mode on vendor acquired messages but our sensors send a
             // vendor message during processing...
-            if (result.first != AcquiredInfo::VENDOR) {
-                mCb->onAcquired(result.first, result.second);
+            if (result.first != AcquiredInfo::VENDOR &&
+                !mAggregator.isDuplicateAcquired(static_cast<int32_t>(result.first),
+                                                 result.second)) {
+                cb->onAcquired(result.first, result.second);
             }
         } break;
         case FINGERPRINT_TEMPLATE_ENROLLING: {
-            LOG(INFO) << "onEnrollResult(fid=" << msg->data.enroll.fid
-                        << ", rem=" << msg->data.enroll.samples_remaining << ")";
-            mCb->onEnrollmentProgress(msg->data.enroll.fid,
+            ALOGD("onEnrollResult(fid=%u, rem=%u)", msg->data.enroll.fid,
+                  msg->data.enroll.samples_remaining);
+            if (msg->data.enroll.samples_remaining == 0) {
+                mEngine->onOperationFinished();
+                mEngine->onEnrollmentsChanged();
+            }
+            cb->onEnrollmentProgress(msg->data.enroll.fid,
                                       msg->data.enroll.samples_remaining);
         } break;
         case FINGERPRINT_TEMPLATE_REMOVED: {
-            LOG(INFO) << "onRemove(fid=" << msg->data.removed.fid
-                        << ", rem=" << msg->data.removed.remaining_templates << ")";
-            std::vector<int> enrollments;
-            enrollments.push_back(msg->data.removed.fid);
-            mCb->onEnrollmentsRemoved(enrollments);
+            ALOGD("onRemove(fid=%u, rem=%u)", msg->data.removed.fid,
+                  msg->data.removed.remaining_templates);
+            if (mAggregator.addRemoved(msg->data.removed.fid,
+                                       msg->data.removed.remaining_templates, &mEnrollments)) {
+                mEngine->onEnrollmentsChanged();
+                cb->onEnrollmentsRemoved(mEnrollments);
+            }
         } break;
         case FINGERPRINT_AUTHENTICATED: {
-            LOG(INFO) << "onAuthenticated(fid=" << msg->data.authenticated.finger.fid << ")";
+            ALOGD("onAuthenticated(fid=%u)", msg->data.authenticated.finger.fid);
+            mEngine->mMetrics.endUnlock(msg->data.authenticated.finger.fid != 0);
+            mEngine->recordUnlock(msg->data.authenticated.finger.fid != 0);
             if (msg->data.authenticated.finger.fid != 0) {
-                const hw_auth_token_t hat = msg->data.authenticated.hat;
-                keymaster::HardwareAuthToken authToken;
-                translate(hat, authToken);
+                translate(msg->data.authenticated.hat, mAuthToken);
 
-                mCb->onAuthenticationSucceeded(msg->data.authenticated.finger.fid, authToken);
+                mEngine->onOperationFinished();
+                cb->onAuthenticationSucceeded(msg->data.authenticated.finger.fid, mAuthToken);
                 mEngine->mLockoutTracker.reset(true);
             } else {
-                mCb->onAuthenticationFailed();
+                cb->onAuthenticationFailed();
                 mEngine->mLockoutTracker.addFailedAttempt();
-                mEngine->checkSensorLockout(mCb.get());
+                mEngine->checkSensorLockout(cb.get());
             }
-            mEngine->onPointerUpImpl(0);
+            mEngine->postPointerUp();
         } break;
         case FINGERPRINT_TEMPLATE_ENUMERATING: {
-            LOG(INFO) << "onEnumerate(fid=" << msg->data.enumerated.fid 
-                        << ", rem=" << msg->data.enumerated.remaining_templates << ")";
-            static std::vector<int> enrollments;
-            enrollments.push_back(msg->data.enumerated.fid);
-            if (msg->data.enumerated.remaining_templates == 0) {
-                mCb->onEnrollmentsEnumerated(enrollments);
-                enrollments.clear();
+            ALOGD("onEnumerate(fid=%u, rem=%u)", msg->data.enumerated.fid,
+                  msg->data.enumerated.remaining_templates);
+            if (mAggregator.addEnumerated(msg->data.enumerated.fid,
+                                          msg->data.enumerated.remaining_templates,
+                                          &mEnrollments)) {
+                cb->onEnrollmentsEnumerated(mEnrollments);
             }
         } break;
         case FINGERPRINT_CHALLENGE_GENERATED: {
             int64_t challenge = msg->data.extend.data;
-            LOG(INFO) << "onChallengeGenerated: " << challenge;
-            mCb->onChallengeGenerated(challenge);
+            ALOGD("onChallengeGenerated: %" PRId64, challenge);
+            cb->onChallengeGenerated(challenge);
         } break;
         case FINGERPRINT_CHALLENGE_REVOKED: {
             int64_t challenge = msg->data.extend.data;
-            LOG(INFO) << "onChallengeRevoked: " << challenge;
-            mCb->onChallengeRevoked(challenge);
+            ALOGD("onChallengeRevoked: %" PRId64, challenge);
+            cb->onChallengeRevoked(challenge);
         } break;
         case FINGERPRINT_AUTHENTICATOR_ID_RETRIEVED: {
             int auth_id = msg->data.extend.data;
-            LOG(INFO) << "onAuthenticatorIDRetrieved: " << auth_id;
-            mEngine->onPointerUpImpl(0);
-            mCb->onAuthenticatorIdRetrieved(auth_id);
+            ALOGD("onAuthenticatorIDRetrieved: %d", auth_id);
+            mEngine->postPointerUp();
+            mEngine->onAuthenticatorId(auth_id);
+            cb->onAuthenticatorIdRetrieved(auth_id);
         } break;
         case FINGERPRINT_AUTHENTICATOR_ID_INVALIDATED: {
             int64_t new_auth_id = msg->data.extend.data;
-            LOG(INFO) <<"onAuthenticatorIDInvalidated, new auth id: " << new_auth_id;
-            mCb->onAuthenticatorIdInvalidated(new_auth_id);
+            ALOGD("onAuthenticatorIDInvalidated, new auth id: %" PRId64, new_auth_id);
+            mEngine->onAuthenticatorId(new_auth_id);
+            cb->onAuthenticatorIdInvalidated(new_auth_id);
         } break;
         default:
-            LOG(ERROR) << "received unknown message: " << msg->type;
+            ALOGE("received unknown message: %d", msg->type);
     }
 }
+
+std::string Session::toString() const {
+    return mAggregator.toString() + mCallbacks.toString();
+}
+
 }  // namespace aidl::android::hardware::biometrics::fingerprint
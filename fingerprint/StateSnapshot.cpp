@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_TAG "FingerprintHalSnapshot"
+
+#include "StateSnapshot.h"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+#include <android-base/unique_fd.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+#include "util/Util.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+namespace {
+
+constexpr uint32_t kMagic = 0x46505353;  // "FPSS"
+constexpr size_t kSlotCount = 2;
+constexpr char kBootIdPath[] = "/proc/sys/kernel/random/boot_id";
+
+constexpr std::array<uint32_t, 256> kCrcTable = [] {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < table.size(); i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}();
+
+uint32_t crc32(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++) {
+        crc = kCrcTable[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+std::string readBootId() {
+    std::string bootId;
+    ::android::base::ReadFileToString(kBootIdPath, &bootId);
+    return ::android::base::Trim(bootId);
+}
+
+}  // namespace
+
+// The checksum covers everything after it.
+struct StateSnapshot::Slot {
+    uint32_t crc;
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint64_t seq;
+    PersistentState state;
+
+    uint32_t checksum() const {
+        return crc32(&magic, sizeof(Slot) - offsetof(Slot, magic));
+    }
+    bool valid() const {
+        return magic == kMagic && version == PersistentState::kVersion &&
+               size == sizeof(PersistentState) && crc == checksum();
+    }
+};
+
+void PersistentState::clearBootScoped() {
+    lockout = {};
+    for (auto& entry : authenticatorIds) {
+        entry = {-1, 0};
+    }
+}
+
+StateSnapshot::StateSnapshot(const char* path)
+    : mPath(path),
+      mState{},
+      mSlots(nullptr),
+      mActive(0),
+      mSeq(0),
+      mRestored(false),
+      mCorruptSlots(0),
+      mCommits(0),
+      mLoadTimeNs(0) {
+    mState.clearBootScoped();
+}
+
+StateSnapshot::~StateSnapshot() {
+    if (mSlots != nullptr) {
+        munmap(mSlots, sizeof(Slot) * kSlotCount);
+    }
+}
+
+bool StateSnapshot::load() {
+    std::lock_guard<std::mutex> lock(mLock);
+    int64_t start = Util::getSystemNanoTime();
+    constexpr size_t kFileSize = sizeof(Slot) * kSlotCount;
+
+    ::android::base::unique_fd fd(
+            TEMP_FAILURE_RETRY(open(mPath, O_RDWR | O_CREAT | O_CLOEXEC, 0600)));
+    if (!fd.ok()) {
+        PLOG(ERROR) << "Failed to open " << mPath << ", state is not kept across restarts";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd.get(), &st) != 0 ||
+        (static_cast<size_t>(st.st_size) != kFileSize && ftruncate(fd.get(), kFileSize) != 0)) {
+        PLOG(ERROR) << "Failed to size " << mPath;
+        return false;
+    }
+    void* map = mmap(nullptr, kFileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+    if (map == MAP_FAILED) {
+        PLOG(ERROR) << "Failed to map " << mPath;
+        return false;
+    }
+    mSlots = static_cast<Slot*>(map);
+
+    const Slot* newest = nullptr;
+    for (size_t i = 0; i < kSlotCount; i++) {
+        const Slot& slot = mSlots[i];
+        if (!slot.valid()) {
+            // A file of an older layout or a torn write, both slots start out like that.
+            if (slot.magic != 0) mCorruptSlots++;
+            continue;
+        }
+        if (newest == nullptr || slot.seq > newest->seq) {
+            newest = &slot;
+            mActive = i;
+        }
+    }
+
+    std::string bootId = readBootId();
+    if (newest != nullptr) {
+        mState = newest->state;
+        mSeq = newest->seq;
+        mRestored = bootId == std::string(mState.bootId, strnlen(mState.bootId,
+                                                                  sizeof(mState.bootId)));
+        if (!mRestored) mState.clearBootScoped();
+    }
+    snprintf(mState.bootId, sizeof(mState.bootId), "%s", bootId.c_str());
+    mLoadTimeNs = Util::getSystemNanoTime() - start;
+
+    LOG(INFO) << "Loaded " << mPath << " seq=" << mSeq << (mRestored ? " (same boot)" : "")
+              << " in " << mLoadTimeNs / 1000000.0 << "ms";
+    return mRestored;
+}
+
+PersistentState StateSnapshot::state() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mState;
+}
+
+void StateSnapshot::update(const std::function<void(PersistentState*)>& change) {
+    std::lock_guard<std::mutex> lock(mLock);
+    change(&mState);
+    commitLocked();
+}
+
+void StateSnapshot::commitLocked() {
+    if (mSlots == nullptr) {
+        return;
+    }
+    size_t next = (mActive + 1) % kSlotCount;
+    Slot& slot = mSlots[next];
+    slot.magic = kMagic;
+    slot.version = PersistentState::kVersion;
+    slot.size = sizeof(PersistentState);
+    slot.seq = mSeq + 1;
+    slot.state = mState;
+    uint32_t crc = slot.checksum();
+    // The crc goes last, so the slot only validates once everything else is in place.
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.crc = crc;
+
+    // The stores above are in the page cache already, so a crash of the service loses nothing.
+    // Start the write to disk now rather than at the kernel's leisure. Should power fail before
+    // it completes, the checksum rejects a torn slot and load() falls back to the other one.
+    static const uintptr_t kPageMask = ~(static_cast<uintptr_t>(getpagesize()) - 1);
+    uintptr_t begin = reinterpret_cast<uintptr_t>(&slot) & kPageMask;
+    uintptr_t end = reinterpret_cast<uintptr_t>(&slot + 1);
+    if (msync(reinterpret_cast<void*>(begin), end - begin, MS_ASYNC) != 0) {
+        PLOG(WARNING) << "Failed to sync " << mPath;
+    }
+
+    mActive = next;
+    mSeq++;
+    mCommits++;
+}
+
+std::string StateSnapshot::toString() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    std::string out = ::android::base::StringPrintf(
+            "%s: seq=%llu %s commits=%llu corruptSlots=%llu load=%.2fms\n", mPath,
+            static_cast<unsigned long long>(mSeq), mRestored ? "restored" : "fresh",
+            static_cast<unsigned long long>(mCommits),
+            static_cast<unsigned long long>(mCorruptSlots), mLoadTimeNs / 1000000.0);
+    ::android::base::StringAppendF(
+            &out,
+            "starts=%llu warm=%llu lastColdStart=%.2fms lastWarmStart=%.2fms unlocks "
+            "success=%llu failure=%llu\n",
+            static_cast<unsigned long long>(mState.starts),
+            static_cast<unsigned long long>(mState.warmStarts), mState.lastColdStartNs / 1000000.0,
+            mState.lastWarmStartNs / 1000000.0, static_cast<unsigned long long>(mState.unlocks[1]),
+            static_cast<unsigned long long>(mState.unlocks[0]));
+    return out;
+}
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
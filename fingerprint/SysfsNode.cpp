@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_TAG "FingerprintHalSysfs"
+
+#include "SysfsNode.h"
+
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+
+#include <charconv>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "util/Util.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+SysfsNode::SysfsNode(const char* path)
+    : mPath(path),
+      mLastSize(0),
+      mLastValid(false),
+      mWrites(0),
+      mSkipped(0),
+      mErrors(0),
+      mReopens(0) {}
+
+bool SysfsNode::write(std::string_view value) {
+    std::lock_guard<std::mutex> lock(mLock);
+    return writeLocked(value);
+}
+
+bool SysfsNode::write(int value) {
+    char buf[kMaxValueSize];
+    auto [end, ec] = std::to_chars(std::begin(buf), std::end(buf), value);
+    if (ec != std::errc()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mLock);
+    return writeLocked(std::string_view(buf, end - buf));
+}
+
+void SysfsNode::invalidate() {
+    std::lock_guard<std::mutex> lock(mLock);
+    mLastValid = false;
+}
+
+bool SysfsNode::writeLocked(std::string_view value) {
+    if (mLastValid && value == std::string_view(mLast.data(), mLastSize)) {
+        mSkipped++;
+        return true;
+    }
+
+    int64_t start = Util::getSystemNanoTime();
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (!mFd.ok()) {
+            mFd.reset(TEMP_FAILURE_RETRY(open(mPath, O_WRONLY | O_CLOEXEC)));
+            if (!mFd.ok()) {
+                PLOG(ERROR) << "Failed to open " << mPath;
+                break;
+            }
+            if (attempt > 0) mReopens++;
+            // A node reopened after a failure may have been reset with it.
+            mLastValid = false;
+        }
+        if (TEMP_FAILURE_RETRY(pwrite(mFd.get(), value.data(), value.size(), 0)) ==
+            static_cast<ssize_t>(value.size())) {
+            mWrites++;
+            mLatency.record(Util::getSystemNanoTime() - start);
+            mLastValid = value.size() <= mLast.size();
+            if (mLastValid) {
+                memcpy(mLast.data(), value.data(), value.size());
+                mLastSize = value.size();
+            }
+            return true;
+        }
+        PLOG(ERROR) << "Failed to write " << mPath;
+        mFd.reset();
+    }
+
+    mErrors++;
+    mLastValid = false;
+    return false;
+}
+
+std::string SysfsNode::toString() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return ::android::base::StringPrintf(
+            "%s: writes=%llu skipped=%llu errors=%llu reopens=%llu latency %s\n", mPath,
+            static_cast<unsigned long long>(mWrites), static_cast<unsigned long long>(mSkipped),
+            static_cast<unsigned long long>(mErrors), static_cast<unsigned long long>(mReopens),
+            mLatency.toString().c_str());
+}
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
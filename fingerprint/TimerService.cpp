@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_TAG "FingerprintHalTimer"
+
+#include "TimerService.h"
+
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "util/Util.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+TimerService::TimerService()
+    : mNextId(kInvalidTimer + 1),
+      mArmedDeadline(0),
+      mFired(0),
+      mCancelled(0),
+      mTimerFd(timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)),
+      mStopFd(eventfd(0, EFD_CLOEXEC)) {
+    CHECK(mTimerFd.ok()) << "Failed to create timerfd";
+    CHECK(mStopFd.ok()) << "Failed to create eventfd";
+    mThread = std::thread([this] { threadFunc(); });
+}
+
+TimerService::~TimerService() {
+    uint64_t one = 1;
+    TEMP_FAILURE_RETRY(write(mStopFd.get(), &one, sizeof(one)));
+    mThread.join();
+}
+
+TimerService::TimerId TimerService::schedule(int64_t delayMs, std::function<void()> action) {
+    int64_t deadline = Util::getSystemNanoTime() + delayMs * 1000000LL;
+    std::lock_guard<std::mutex> lock(mLock);
+    TimerId id = mNextId++;
+    mActions.emplace(id, std::move(action));
+    mDeadlines.emplace(deadline, id);
+    rearmLocked();
+    return id;
+}
+
+bool TimerService::cancel(TimerId id) {
+    if (id == kInvalidTimer) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mActions.erase(id) == 0) {
+        return false;
+    }
+    mCancelled++;
+    return true;
+}
+
+void TimerService::rearmLocked() {
+    while (!mDeadlines.empty() && mActions.count(mDeadlines.top().second) == 0) {
+        mDeadlines.pop();
+    }
+    int64_t deadline = mDeadlines.empty() ? 0 : mDeadlines.top().first;
+    if (deadline == mArmedDeadline) {
+        return;
+    }
+
+    // An all-zero it_value disarms the timer.
+    itimerspec spec = {};
+    spec.it_value.tv_sec = deadline / 1000000000LL;
+    spec.it_value.tv_nsec = deadline % 1000000000LL;
+    if (timerfd_settime(mTimerFd.get(), TFD_TIMER_ABSTIME, &spec, nullptr) != 0) {
+        PLOG(ERROR) << "Failed to arm timerfd";
+        return;
+    }
+    mArmedDeadline = deadline;
+}
+
+void TimerService::threadFunc() {
+    pollfd fds[] = {
+            {.fd = mTimerFd.get(), .events = POLLIN},
+            {.fd = mStopFd.get(), .events = POLLIN},
+    };
+    std::vector<std::function<void()>> expired;
+
+    while (true) {
+        if (TEMP_FAILURE_RETRY(poll(fds, std::size(fds), -1)) < 0) {
+            PLOG(ERROR) << "Failed to poll timerfd";
+            return;
+        }
+        if (fds[1].revents & POLLIN) {
+            return;
+        }
+
+        uint64_t expirations;
+        TEMP_FAILURE_RETRY(read(mTimerFd.get(), &expirations, sizeof(expirations)));
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            int64_t now = Util::getSystemNanoTime();
+            while (!mDeadlines.empty() && mDeadlines.top().first <= now) {
+                auto action = mActions.find(mDeadlines.top().second);
+                if (action != mActions.end()) {
+                    expired.push_back(std::move(action->second));
+                    mActions.erase(action);
+                    mFired++;
+                }
+                mDeadlines.pop();
+            }
+            mArmedDeadline = 0;
+            rearmLocked();
+        }
+
+        for (auto& action : expired) {
+            action();
+        }
+        expired.clear();
+    }
+}
+
+std::string TimerService::toString() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return ::android::base::StringPrintf("----- Timers -----\npending=%zu fired=%llu cancelled=%llu\n",
+                                         mActions.size(), static_cast<unsigned long long>(mFired),
+                                         static_cast<unsigned long long>(mCancelled));
+}
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_TAG "FingerprintHalTouch"
+
+#include "TouchInputReader.h"
+
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+
+#include <fcntl.h>
+#include <linux/input.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <ctime>
+#include <iterator>
+
+#include "FingerprintTrace.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+namespace {
+
+constexpr size_t kReadBatch = 64;
+
+int64_t eventTimeNs(const input_event& event) {
+    return static_cast<int64_t>(event.input_event_sec) * 1000000000LL +
+           static_cast<int64_t>(event.input_event_usec) * 1000LL;
+}
+
+}  // namespace
+
+TouchInputReader::TouchInputReader(DownHandler onDown, UpHandler onUp)
+    : mOnDown(std::move(onDown)), mOnUp(std::move(onUp)), mSlot(0), mDropping(false) {}
+
+TouchInputReader::~TouchInputReader() {
+    if (mThread.joinable()) {
+        uint64_t one = 1;
+        TEMP_FAILURE_RETRY(write(mStopFd.get(), &one, sizeof(one)));
+        mThread.join();
+    }
+}
+
+bool TouchInputReader::start(const std::string& path) {
+    mPath = path;
+    mInputFd.reset(TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC)));
+    if (!mInputFd.ok()) {
+        PLOG(ERROR) << "Failed to open " << path;
+        return false;
+    }
+    // Same clock as Util::getSystemNanoTime(), so event times can be compared with ours.
+    int clock = CLOCK_MONOTONIC;
+    if (ioctl(mInputFd.get(), EVIOCSCLOCKID, &clock) != 0) {
+        PLOG(WARNING) << "Failed to switch " << path << " to CLOCK_MONOTONIC";
+    }
+
+    mEpollFd.reset(epoll_create1(EPOLL_CLOEXEC));
+    mStopFd.reset(eventfd(0, EFD_CLOEXEC));
+    if (!mEpollFd.ok() || !mStopFd.ok()) {
+        PLOG(ERROR) << "Failed to create epoll/eventfd";
+        return false;
+    }
+    epoll_event input = {.events = EPOLLIN, .data = {.fd = mInputFd.get()}};
+    epoll_event stop = {.events = EPOLLIN, .data = {.fd = mStopFd.get()}};
+    if (epoll_ctl(mEpollFd.get(), EPOLL_CTL_ADD, mInputFd.get(), &input) != 0 ||
+        epoll_ctl(mEpollFd.get(), EPOLL_CTL_ADD, mStopFd.get(), &stop) != 0) {
+        PLOG(ERROR) << "Failed to watch " << path;
+        return false;
+    }
+
+    mThread = std::thread([this] { threadFunc(); });
+    LOG(INFO) << "Reading touch events from " << path;
+    return true;
+}
+
+void TouchInputReader::threadFunc() {
+    input_event events[kReadBatch];
+    epoll_event ready[2];
+
+    while (true) {
+        int count = TEMP_FAILURE_RETRY(epoll_wait(mEpollFd.get(), ready, std::size(ready), -1));
+        if (count < 0) {
+            PLOG(ERROR) << "epoll_wait failed";
+            return;
+        }
+        for (int i = 0; i < count; i++) {
+            if (ready[i].data.fd == mStopFd.get()) {
+                return;
+            }
+        }
+
+        ssize_t size;
+        while ((size = TEMP_FAILURE_RETRY(read(mInputFd.get(), events, sizeof(events)))) > 0) {
+            size_t n = size / sizeof(input_event);
+            mEvents.fetch_add(n, std::memory_order_relaxed);
+            for (size_t i = 0; i < n; i++) {
+                handleEvent(events[i]);
+            }
+        }
+        if (size == 0 || (size < 0 && errno != EAGAIN)) {
+            PLOG(ERROR) << "Lost " << mPath;
+            releaseAll(0);
+            return;
+        }
+    }
+}
+
+void TouchInputReader::handleEvent(const input_event& event) {
+    if (event.type == EV_SYN) {
+        if (event.code == SYN_DROPPED) {
+            // The kernel buffer overflowed: ignore everything up to the next report, then
+            // read the slot state back from the kernel.
+            mSynDropped.fetch_add(1, std::memory_order_relaxed);
+            mDropping = true;
+        } else if (event.code == SYN_REPORT) {
+            if (mDropping) {
+                mDropping = false;
+                resync();
+            }
+            sync(eventTimeNs(event));
+        }
+        return;
+    }
+    if (event.type != EV_ABS || mDropping) {
+        return;
+    }
+
+    switch (event.code) {
+        case ABS_MT_SLOT:
+            mSlot = event.value;
+            break;
+        case ABS_MT_TRACKING_ID:
+            if (mSlot >= 0 && mSlot < kMaxSlots) mContacts[mSlot].trackingId = event.value;
+            break;
+        case ABS_MT_POSITION_X:
+            if (mSlot >= 0 && mSlot < kMaxSlots) mContacts[mSlot].x = event.value;
+            break;
+        case ABS_MT_POSITION_Y:
+            if (mSlot >= 0 && mSlot < kMaxSlots) mContacts[mSlot].y = event.value;
+            break;
+    }
+}
+
+void TouchInputReader::sync(int64_t timeNs) {
+    for (int32_t slot = 0; slot < kMaxSlots; slot++) {
+        Contact& contact = mContacts[slot];
+        if (contact.trackingId >= 0 && !contact.reported && contact.x >= 0 && contact.y >= 0) {
+            contact.reported = true;
+            mDowns.fetch_add(1, std::memory_order_relaxed);
+            FP_TRACE_NAME("FpTouchDown");
+            mOnDown(slot, contact.x, contact.y, timeNs);
+        } else if (contact.trackingId < 0 && contact.reported) {
+            contact = Contact();
+            mUps.fetch_add(1, std::memory_order_relaxed);
+            FP_TRACE_NAME("FpTouchUp");
+            mOnUp(slot, timeNs);
+        }
+    }
+}
+
+void TouchInputReader::resync() {
+    struct {
+        uint32_t code;
+        int32_t values[kMaxSlots];
+    } slots;
+
+    constexpr uint32_t kCodes[] = {ABS_MT_TRACKING_ID, ABS_MT_POSITION_X, ABS_MT_POSITION_Y};
+    for (uint32_t code : kCodes) {
+        slots.code = code;
+        if (ioctl(mInputFd.get(), EVIOCGMTSLOTS(sizeof(slots)), &slots) != 0) {
+            PLOG(ERROR) << "Failed to read back slot state";
+            return;
+        }
+        for (int32_t slot = 0; slot < kMaxSlots; slot++) {
+            Contact& contact = mContacts[slot];
+            if (code == ABS_MT_TRACKING_ID) contact.trackingId = slots.values[slot];
+            if (code == ABS_MT_POSITION_X) contact.x = slots.values[slot];
+            if (code == ABS_MT_POSITION_Y) contact.y = slots.values[slot];
+        }
+    }
+    input_absinfo slot;
+    if (ioctl(mInputFd.get(), EVIOCGABS(ABS_MT_SLOT), &slot) == 0) mSlot = slot.value;
+}
+
+void TouchInputReader::releaseAll(int64_t timeNs) {
+    for (int32_t slot = 0; slot < kMaxSlots; slot++) {
+        if (mContacts[slot].reported) {
+            mUps.fetch_add(1, std::memory_order_relaxed);
+            mOnUp(slot, timeNs);
+        }
+        mContacts[slot] = Contact();
+    }
+}
+
+std::string TouchInputReader::toString() const {
+    return ::android::base::StringPrintf(
+            "%s: events=%llu downs=%llu ups=%llu synDropped=%llu\n", mPath.c_str(),
+            static_cast<unsigned long long>(mEvents.load()),
+            static_cast<unsigned long long>(mDowns.load()),
+            static_cast<unsigned long long>(mUps.load()),
+            static_cast<unsigned long long>(mSynDropped.load()));
+}
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
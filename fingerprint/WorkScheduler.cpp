@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_TAG "FingerprintHalScheduler"
+
+#include "WorkScheduler.h"
+
+#include <algorithm>
+
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+
+#include "FingerprintTrace.h"
+#include "PooledCallable.h"
+#include "util/Util.h"
+
+using ::android::base::StringAppendF;
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+namespace {
+
+// Scheduler and generation of the worker thread running on this thread, if any.
+thread_local const WorkScheduler* tScheduler = nullptr;
+thread_local uint64_t tGeneration = 0;
+
+}  // namespace
+
+WorkScheduler::WorkScheduler(size_t maxQueueSize)
+    : mMaxSize(maxQueueSize),
+      mIsDestructing(false),
+      mGeneration(0),
+      mThread([this] { threadFunc(0); }) {}
+
+WorkScheduler::~WorkScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(mQueueMutex);
+        mIsDestructing = true;
+    }
+    mQueueCond.notify_all();
+    mThread.join();
+}
+
+bool WorkScheduler::schedule(std::unique_ptr<Callable> task) {
+    return schedule(TaskKind::kTerminal, std::move(task));
+}
+
+bool WorkScheduler::schedule(TaskKind kind, std::unique_ptr<Callable> task, int32_t pointerId) {
+    Task entry{kind, pointerId, Util::getSystemNanoTime(), std::move(task)};
+    Lane lane = laneFor(kind);
+    {
+        std::lock_guard<std::mutex> lock(mQueueMutex);
+        if (mIsDestructing) {
+            return false;
+        }
+        if (coalesceLocked(entry)) {
+            traceDepthLocked(kHigh);
+            return true;
+        }
+        auto& queue = mQueues[lane];
+        if (queue.size() >= mMaxSize) {
+            if (lane == kNormal) {
+                mOverflowAdmitted++;
+                LOG(WARNING) << "Worker queue is full, admitting terminal operation anyway";
+            } else {
+                evictLocked(lane);
+            }
+        }
+        if (kind == TaskKind::kRecovery) {
+            // Anything queued before it would go to the hung device.
+            queue.push_front(std::move(entry));
+        } else {
+            queue.push_back(std::move(entry));
+        }
+        mMaxDepth[lane] = std::max(mMaxDepth[lane], queue.size());
+        traceDepthLocked(lane);
+    }
+    mQueueCond.notify_one();
+    return true;
+}
+
+bool WorkScheduler::coalesceLocked(const Task& task) {
+    if (task.kind != TaskKind::kPointerUp) {
+        return false;
+    }
+    // The finger is already gone: a pending down for the same pointer is stale and arming the
+    // sensor for it would only flash local HBM.
+    auto& queue = mQueues[kHigh];
+    auto down = std::find_if(queue.rbegin(), queue.rend(), [&task](const Task& t) {
+        return t.kind == TaskKind::kPointerDown && t.pointerId == task.pointerId;
+    });
+    if (down == queue.rend()) {
+        return false;
+    }
+    queue.erase(std::next(down).base());
+    mCoalesced++;
+    return true;
+}
+
+void WorkScheduler::evictLocked(Lane lane) {
+    auto& queue = mQueues[lane];
+    auto victim = std::find_if(queue.begin(), queue.end(),
+                               [](const Task& t) { return isEvictable(t.kind); });
+    if (victim == queue.end()) {
+        mOverflowAdmitted++;
+        return;
+    }
+    LOG(WARNING) << "High priority queue is full, dropping task kind "
+                 << static_cast<int>(victim->kind);
+    queue.erase(victim);
+    mDropped++;
+}
+
+void WorkScheduler::traceDepthLocked(Lane lane) {
+    ATRACE_INT(lane == kHigh ? kTraceQueueHigh : kTraceQueueNormal,
+               static_cast<int32_t>(mQueues[lane].size()));
+}
+
+bool WorkScheduler::abandonThread(std::thread::id stuck, std::unique_ptr<Callable> recovery) {
+    {
+        std::lock_guard<std::mutex> lock(mQueueMutex);
+        if (mIsDestructing || stuck != mThread.get_id()) {
+            return false;
+        }
+        // Queued in the same critical section, so the new thread can't start on a task that
+        // goes to the hung device before it.
+        mQueues[kHigh].push_front(
+                Task{TaskKind::kRecovery, 0, Util::getSystemNanoTime(), std::move(recovery)});
+        uint64_t generation = ++mGeneration;
+        mAbandoned++;
+        // Swapped under the lock, the destructor joins whichever thread is current once it set
+        // mIsDestructing.
+        mThread.detach();
+        mThread = std::thread([this, generation] { threadFunc(generation); });
+    }
+    LOG(WARNING) << "Abandoned the stuck worker thread";
+    return true;
+}
+
+bool WorkScheduler::isWorkerThread() const {
+    return tScheduler == this && tGeneration == mGeneration.load();
+}
+
+bool WorkScheduler::isAbandonedThread() const {
+    return tScheduler == this && tGeneration != mGeneration.load();
+}
+
+void WorkScheduler::threadFunc(uint64_t generation) {
+    tScheduler = this;
+    tGeneration = generation;
+    while (true) {
+        Task task;
+        Lane lane;
+        {
+            std::unique_lock<std::mutex> lock(mQueueMutex);
+            mQueueCond.wait(lock, [this, generation] {
+                return mIsDestructing || generation != mGeneration ||
+                       !mQueues[kHigh].empty() || !mQueues[kNormal].empty();
+            });
+            if (mIsDestructing || generation != mGeneration) {
+                return;
+            }
+            lane = mQueues[kHigh].empty() ? kNormal : kHigh;
+            task = std::move(mQueues[lane].front());
+            mQueues[lane].pop_front();
+            traceDepthLocked(lane);
+        }
+        mWaitTime[lane].record(Util::getSystemNanoTime() - task.enqueueTime);
+        (*task.callable)();
+    }
+}
+
+std::string WorkScheduler::toString() const {
+    std::lock_guard<std::mutex> lock(mQueueMutex);
+    std::string out = "----- Worker -----\n";
+    StringAppendF(&out, "high:   depth=%zu maxDepth=%zu wait %s\n", mQueues[kHigh].size(),
+                  mMaxDepth[kHigh], mWaitTime[kHigh].toString().c_str());
+    StringAppendF(&out, "normal: depth=%zu maxDepth=%zu wait %s\n", mQueues[kNormal].size(),
+                  mMaxDepth[kNormal], mWaitTime[kNormal].toString().c_str());
+    StringAppendF(&out, "coalesced=%llu dropped=%llu overflowAdmitted=%llu abandoned=%llu\n",
+                  static_cast<unsigned long long>(mCoalesced),
+                  static_cast<unsigned long long>(mDropped),
+                  static_cast<unsigned long long>(mOverflowAdmitted),
+                  static_cast<unsigned long long>(mAbandoned));
+    out += CallablePool::toString();
+    return out;
+}
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+// Folds the vendor's one-message-per-template sequences into a single framework callback per
+// operation, and drops acquired messages that repeat the previous one. Owned by a session, so
+// nothing leaks from one client to the next.
+class CallbackAggregator {
+  public:
+    // Acquired messages identical to the previous one within this window are dropped.
+    static constexpr int64_t kAcquiredWindowMs = 100;
+
+    // Adds a template to the pending list. Returns true with the complete list in out once
+    // the vendor reports no remaining templates. A template ID of 0 only terminates the list.
+    bool addRemoved(int32_t fid, uint32_t remaining, std::vector<int32_t>* out);
+    bool addEnumerated(int32_t fid, uint32_t remaining, std::vector<int32_t>* out);
+
+    // Whether the acquired message repeats the previous one and does not need to reach the
+    // framework.
+    bool isDuplicateAcquired(int32_t info, int32_t vendorCode);
+    // Any other message ends a run of acquired messages.
+    void endAcquired();
+
+    // The operation failed: returns true with the templates already removed in out, which still
+    // have to be reported, and drops everything else.
+    bool abort(std::vector<int32_t>* out);
+    void reset();
+
+    std::string toString() const;
+
+  private:
+    bool addLocked(std::vector<int32_t>* pending, int32_t fid, uint32_t remaining,
+                   std::vector<int32_t>* out);
+
+    mutable std::mutex mLock;
+    std::vector<int32_t> mRemoved;
+    std::vector<int32_t> mEnumerated;
+    int32_t mLastInfo = -1;
+    int32_t mLastVendorCode = 0;
+    int64_t mLastAcquiredNs = 0;
+
+    uint64_t mMessages = 0;
+    uint64_t mCallbacks = 0;
+    uint64_t mDuplicateAcquired = 0;
+    uint64_t mAborted = 0;
+};
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
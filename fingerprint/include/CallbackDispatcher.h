@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/biometrics/fingerprint/ISessionCallback.h>
+
+#include <array>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FingerprintMetrics.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+// Delivers a session's ISessionCallback calls on a thread of its own, in the order they were
+// made, so a slow transaction into system_server never holds up the worker, the notify thread
+// or a binder thread. Each transaction is timed per callback method. Calls are copied into
+// reused queue slots rather than closures, so once the slots have grown to fit, queueing does
+// not allocate.
+class CallbackDispatcher {
+  public:
+    enum class Method : uint8_t {
+        kChallengeGenerated = 0,
+        kChallengeRevoked,
+        kAcquired,
+        kError,
+        kEnrollmentProgress,
+        kAuthenticationSucceeded,
+        kAuthenticationFailed,
+        kLockoutTimed,
+        kLockoutPermanent,
+        kLockoutCleared,
+        kInteractionDetected,
+        kEnrollmentsEnumerated,
+        kEnrollmentsRemoved,
+        kAuthenticatorIdRetrieved,
+        kAuthenticatorIdInvalidated,
+        kSessionClosed,
+        kCount,
+    };
+
+    // Transactions that take longer are logged.
+    static constexpr int64_t kSlowCallMs = 100;
+
+    CallbackDispatcher();
+    // Delivers everything still queued, then stops.
+    ~CallbackDispatcher();
+
+    CallbackDispatcher(const CallbackDispatcher&) = delete;
+    CallbackDispatcher& operator=(const CallbackDispatcher&) = delete;
+
+    // Returns a callback whose methods queue the call for target and return right away. It
+    // must not outlive the dispatcher.
+    std::shared_ptr<ISessionCallback> wrap(std::shared_ptr<ISessionCallback> target);
+
+    // Queues method for target. value and code carry the scalar arguments in the order of the
+    // ISessionCallback method, e.g. the AcquiredInfo and vendor code of onAcquired.
+    void post(const std::shared_ptr<ISessionCallback>& target, Method method, int64_t value = 0,
+              int32_t code = 0);
+    void postAuthenticated(const std::shared_ptr<ISessionCallback>& target, int32_t enrollmentId,
+                           const keymaster::HardwareAuthToken& hat);
+    void postEnrollments(const std::shared_ptr<ISessionCallback>& target, Method method,
+                         const std::vector<int32_t>& ids);
+
+    std::string toString() const;
+
+  private:
+    static constexpr size_t kMethodCount = static_cast<size_t>(Method::kCount);
+    // Enough for the acquired messages of a capture and the result behind them.
+    static constexpr size_t kInitialSlots = 16;
+
+    struct Call {
+        std::shared_ptr<ISessionCallback> target;
+        Method method;
+        int64_t enqueueTime;
+        int64_t value;
+        int32_t code;
+        // Only set for the methods that take them. Assigned into, so they keep their capacity.
+        keymaster::HardwareAuthToken hat;
+        std::vector<int32_t> ids;
+    };
+
+    // Returns the slot at the back of the queue with the common fields set, growing the queue
+    // when it is full. Called with mLock held.
+    Call& pushLocked(const std::shared_ptr<ISessionCallback>& target, Method method);
+    void threadFunc();
+    static ndk::ScopedAStatus deliver(const Call& call);
+
+    mutable std::mutex mLock;
+    std::condition_variable mCond;
+    // Ring of mSize queued calls starting at mHead.
+    std::vector<Call> mSlots;
+    size_t mHead;
+    size_t mSize;
+    bool mIsDestructing;
+    // The call being delivered, swapped with the head slot. Only used by the dispatcher thread.
+    Call mCurrent;
+
+    // Guarded by mLock.
+    size_t mMaxDepth;
+    uint64_t mGrown;
+    uint64_t mFailed;
+    uint64_t mSlow;
+    LatencyHistogram mQueueTime;
+    std::array<LatencyHistogram, kMethodCount> mCallTime;
+
+    std::thread mThread;
+};
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
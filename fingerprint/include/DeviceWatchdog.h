@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "FingerprintMetrics.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+// Watches calls into the vendor device from the worker thread. A call is only bracketed by a
+// Scope: entering and leaving it takes an uncontended lock, the watchdog thread is only woken
+// for the first call after an idle period and sleeps until the deadline of the call in flight.
+// A call still running past its deadline is given up on: the hang handler runs on the watchdog
+// thread and the Scope reports the call as abandoned if it ever returns.
+class DeviceWatchdog {
+  public:
+    // Runs on the watchdog thread, caller is the thread stuck in the call.
+    using HangHandler =
+            std::function<void(const char* call, int64_t startNs, std::thread::id caller)>;
+
+    class Scope {
+      public:
+        // A timeout of 0 leaves the call unwatched.
+        Scope(DeviceWatchdog* watchdog, const char* call, int64_t timeoutMs);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        // Whether the watchdog gave up on this call while it was running.
+        bool abandoned() const;
+
+      private:
+        DeviceWatchdog* const mWatchdog;
+        uint64_t mSeq;
+    };
+
+    explicit DeviceWatchdog(HangHandler onHang);
+    ~DeviceWatchdog();
+
+    DeviceWatchdog(const DeviceWatchdog&) = delete;
+    DeviceWatchdog& operator=(const DeviceWatchdog&) = delete;
+
+    std::string toString() const;
+
+  private:
+    uint64_t enter(const char* call, int64_t timeoutMs);
+    void leave(uint64_t seq);
+    void threadFunc();
+
+    HangHandler mOnHang;
+
+    mutable std::mutex mLock;
+    std::condition_variable mCond;
+    // Call in flight, nullptr if none.
+    const char* mCall;
+    std::thread::id mCaller;
+    int64_t mStartNs;
+    int64_t mDeadlineNs;
+    uint64_t mSeq;
+    uint64_t mAbandonedSeq;
+    bool mIdle;
+    bool mIsDestructing;
+
+    uint64_t mCalls;
+    uint64_t mHangs;
+    const char* mLastHang;
+    LatencyHistogram mCallTime;
+
+    std::thread mThread;
+};
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
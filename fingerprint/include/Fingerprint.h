@@ -18,11 +18,17 @@
 
 #include <aidl/android/hardware/biometrics/fingerprint/BnFingerprint.h>
 
-#include "FingerprintEngine.h"
+#include <array>
+#include <list>
+#include <utility>
+
+#include "FingerprintEngineSelect.h"
 
 #include "FingerprintConfig.h"
+#include "NotifyDispatcher.h"
 #include "Session.h"
-#include "thread/WorkerThread.h"
+#include "TimerService.h"
+#include "WorkScheduler.h"
 
 namespace aidl::android::hardware::biometrics::fingerprint {
 
@@ -36,22 +42,49 @@ class Fingerprint : public BnFingerprint {
                                      const std::shared_ptr<ISessionCallback>& cb,
                                      std::shared_ptr<ISession>* out) override;
 
+    binder_status_t dump(int fd, const char** args, uint32_t numArgs) override;
+
     static FingerprintConfig& cfg() {
-        static FingerprintConfig* cfg = nullptr;
-        if (cfg == nullptr) {
-            cfg = new FingerprintConfig();
-            cfg->init();
-        }
+        static FingerprintConfig* cfg = [] {
+            auto* config = new FingerprintConfig();
+            config->init();
+            return config;
+        }();
         return *cfg;
     }
 
-    static void notify(const fingerprint_msg_t* msg);
+    // Returns the callback to register with a newly opened vendor device. Messages from devices
+    // opened before are dropped from then on, their threads may outlive a recovery.
+    static fingerprint_notify_t nextNotify();
+    // Delivers a message the HAL made up as if it came from the vendor, from any thread.
+    static void inject(const fingerprint_msg_t& msg);
 
   private:
-    std::unique_ptr<FingerprintEngine> mEngine;
-    WorkerThread mWorker;
+    static void notify(const fingerprint_msg_t* msg, uint32_t generation);
+    template <uint32_t kGeneration>
+    static void notifyGeneration(const fingerprint_msg_t* msg) {
+        notify(msg, kGeneration);
+    }
+    template <uint32_t... kGeneration>
+    static constexpr std::array<fingerprint_notify_t, sizeof...(kGeneration)> notifyTable(
+            std::integer_sequence<uint32_t, kGeneration...>) {
+        return {&notifyGeneration<kGeneration>...};
+    }
+
+    void dispatchNotify(const fingerprint_msg_t& msg);
+
+    std::unique_ptr<Engine> mEngine;
+    WorkScheduler mWorker;
+    TimerService mTimers;
+    std::mutex mSessionLock;
     std::shared_ptr<Session> mSession;
+    // Recently closed sessions, most recent first, reused when the same user comes back.
+    std::list<std::shared_ptr<Session>> mSessionPool;
+    // Time spent in createSession, indexed by whether a pooled session was reused.
+    std::array<LatencyHistogram, 2> mSessionSwitchTime;
     FingerprintSensorType mSensorType;
+    // Declared last so it is stopped before the session and engine go away.
+    NotifyDispatcher mNotifyDispatcher;
 };
 
 }  // namespace aidl::android::hardware::biometrics::fingerprint
@@ -16,12 +16,66 @@
 
 #pragma once
 
+#include <aidl/android/hardware/biometrics/fingerprint/SensorLocation.h>
+
+#include <array>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include "SchedBoost.h"
+#include "SensorHitTest.h"
 #include "config/Config.h"
 
+struct prop_info;
+
 namespace aidl::android::hardware::biometrics::fingerprint {
 
+// Immutable, typed view of the persist.vendor.fingerprint.* properties.
+struct FingerprintConfigSnapshot {
+    std::string type;
+    int32_t sensorId;
+    SensorLocation sensorLocation;
+    int32_t sensorStrength;
+    bool navigationGuesture;
+    bool detectInteraction;
+    bool displayTouch;
+    bool controlIllumination;
+    bool touchInput;
+    std::string touchDevice;
+    bool pressNotify;
+    std::string powerKeyDevice;
+    HitTestConfig hitTest;
+    int32_t authenticateTimeoutMs;
+    int32_t binderThreads;
+    SchedBoost::Policy boost;
+    int32_t watchdogMs;
+};
+
 class FingerprintConfig : public Config {
+  public:
+    // Cheap enough for hot paths: while no system property changed this is two atomic loads.
+    // Otherwise the serials of our own properties are compared and the snapshot is rebuilt
+    // only if one of them changed. Returned references stay valid for the process lifetime.
+    const FingerprintConfigSnapshot& snapshot();
+
+  private:
+    static constexpr size_t kPropertyCount = 20;
+    static const std::array<const char*, kPropertyCount> kPropertyNames;
+
     Config::Data* getConfigData(int* size) override;
+
+    const FingerprintConfigSnapshot& refresh(uint32_t areaSerial);
+    SensorLocation parseSensorLocation(const std::string& loc);
+
+    std::atomic<uint32_t> mAreaSerial{0};
+    std::atomic<const FingerprintConfigSnapshot*> mCurrent{nullptr};
+
+    std::mutex mRefreshLock;
+    std::array<const prop_info*, kPropertyCount> mPropInfos{};
+    std::array<uint32_t, kPropertyCount> mPropSerials{};
+    std::deque<std::unique_ptr<const FingerprintConfigSnapshot>> mSnapshots;
 };
 
 }  // namespace aidl::android::hardware::biometrics::fingerprint
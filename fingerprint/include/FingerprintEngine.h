@@ -26,22 +26,112 @@
 #include <random>
 
 #include <aidl/android/hardware/biometrics/fingerprint/SensorLocation.h>
+#include <array>
+#include <atomic>
+#include <condition_variable>
 #include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
+#include "DeviceWatchdog.h"
+#include "FingerprintMetrics.h"
+#include "FodPressWatcher.h"
+#include "FodStateMachine.h"
+#include "IlluminationThread.h"
 #include "LockoutTracker.h"
+#include "SchedBoost.h"
+#include "SensorHitTest.h"
+#include "StateSnapshot.h"
+#include "SysfsNode.h"
+#include "TimerService.h"
+#include "TouchInputReader.h"
+#include "WorkScheduler.h"
 
-#include <fstream>
 #include "fingerprint-xiaomi.h"
 
 using namespace ::aidl::android::hardware::biometrics::common;
 
+// The engine class a build is fixed to is final, see FingerprintEngineSelect.h.
+#if defined(FINGERPRINT_SENSOR_TYPE_UDFPS) || defined(FINGERPRINT_SENSOR_TYPE_UDFPS_US)
+#define FINGERPRINT_UDFPS_FINAL final
+#else
+#define FINGERPRINT_UDFPS_FINAL
+#endif
+#if defined(FINGERPRINT_SENSOR_TYPE_SIDE)
+#define FINGERPRINT_SIDE_FINAL final
+#else
+#define FINGERPRINT_SIDE_FINAL
+#endif
+#if defined(FINGERPRINT_SENSOR_TYPE_REAR)
+#define FINGERPRINT_REAR_FINAL final
+#else
+#define FINGERPRINT_REAR_FINAL
+#endif
+
 namespace aidl::android::hardware::biometrics::fingerprint {
 
-class FingerprintEngine {
+class FingerprintEngine FINGERPRINT_UDFPS_FINAL : private FodActuator {
   public:
+    // Deadline for onUiReady() after onPointerDown().
+    static constexpr int64_t kUiReadyTimeoutMs = 5000;
+    // Local HBM is turned off if onPointerUp() never arrives.
+    static constexpr int64_t kHbmSafetyTimeoutMs = 3000;
+    // Same as the timeout the legacy HIDL service used for enrollment.
+    static constexpr int64_t kEnrollTimeoutMs = 60000;
+    // Scheduler boosts of an operation are dropped after this long without a finger down.
+    static constexpr int64_t kBoostTimeoutMs = 3000;
+    // Longest the press status waits for the panel to light up.
+    static constexpr int64_t kIlluminationTimeoutMs = 100;
+    // Longest a new operation waits for the CANCELED of the one it preempted.
+    static constexpr int64_t kPreemptTimeoutMs = 200;
+    // Vendor device hangs, recoveries included, within kHangWindowMs after which the service
+    // gives up and lets init restart it.
+    static constexpr uint32_t kMaxHangs = 3;
+    static constexpr int64_t kHangWindowMs = 60000;
+    // Reopening the device after a hang is retried this many times, kRecoveryRetryMs apart,
+    // before the service gives up.
+    static constexpr uint32_t kMaxRecoveryAttempts = 3;
+    static constexpr int64_t kRecoveryRetryMs = 1000;
+
     FingerprintEngine();
-    virtual ~FingerprintEngine() {}
+    virtual ~FingerprintEngine();
+
+    // Pointer IDs used for finger downs seen on the touch node, one per multi-touch slot.
+    static constexpr int32_t kTouchPointerBase = 1000;
+    // Slot of finger downs seen on fod_press_status, past any multi-touch slot.
+    static constexpr int32_t kPressSlot = 100;
+    // Pointer ID of the pointer ups the vendor messages imply, never used by a finger down.
+    static constexpr int32_t kVendorPointer = -1;
+
+    // Provides the threads used for timeouts. Timer actions always run on the worker. Also
+    // starts the touch reader when persist.vendor.fingerprint.udfps.touch_input is set and the
+    // press watcher when persist.vendor.fingerprint.udfps.press_notify is set.
+    virtual void attach(WorkScheduler* worker, TimerService* timers);
+    // Sensor type this engine drives, for logs and dumps.
+    virtual const char* typeName() const { return "udfps"; }
+    // Runs on the notify dispatcher thread before the message reaches the session. Returns true
+    // if the engine consumed it: the CANCELED of a preempted operation is dropped here.
+    virtual bool interceptNotify(const fingerprint_msg_t& msg);
+    // Cancels every timer that may call back into the closed session.
+    void onSessionClosed();
+    // Called on the terminal message of an enroll/authenticate operation.
+    void onOperationFinished();
+    // Whether the vendor's CANCELED error was caused by an operation deadline.
+    bool consumeOperationTimeout();
+
+    // Enroll, authenticate and detectInteraction are tracked as operations. queueOperation()
+    // runs on the binder thread and supersedes every older operation. startOperation() runs on
+    // the worker right before the vendor call: it returns false for a superseded operation and
+    // preempts a stale one that is still running in the device. The vendor's CANCELED carries
+    // no operation, so the new one only goes to the device once the preempted one's CANCELED
+    // was dropped, or kPreemptTimeoutMs passed: any CANCELED after that is its own.
+    // Each operation gets an async trace track named after it, from queueing to completion.
+    uint64_t queueOperation(const char* name);
+    bool startOperation(uint64_t op);
+    // Runs on the high-priority lane as soon as the cancellation signal fires.
+    void cancelOperation(uint64_t op);
 
     void setActiveGroup(int userId);
     void generateChallengeImpl(ISessionCallback* cb);
@@ -57,15 +147,51 @@ class FingerprintEngine {
     void invalidateAuthenticatorIdImpl(ISessionCallback* cb);
     void resetLockoutImpl(ISessionCallback* cb, const keymaster::HardwareAuthToken& hat);
 
+    // Finger down/up seen on the touch node, run on the reader thread. A down inside the sensor
+    // while an operation is running starts the finger down sequence before the framework's
+    // onPointerDown, which is then deduplicated.
+    void onTouchDown(int32_t slot, int32_t x, int32_t y, int64_t timeNs);
+    void onTouchUp(int32_t slot, int64_t timeNs);
+    // Press on the sensor area reported by the touch driver, run on the watcher thread. Same
+    // early finger down as a touch, at the sensor center; it works with the display off.
+    void onFodPress(bool pressed, int64_t timeNs);
+    // Validates a touch against the sensor before anything gets armed. Cheap enough for the
+    // binder thread, counts the outcome.
+    bool acceptTouch(int32_t x, int32_t y, float minor, float major);
+    // Starts unlock metrics, unless a touch down already did for this finger.
+    void beginUnlock();
+
+    // Start-up is split in two. The constructor and attach() only need /vendor: the module is
+    // opened and the service can be registered early in boot. onStarted() ends that phase and
+    // starts the second one, which waits for init to report /data as ready and then loads the
+    // state snapshot; setActiveGroup() blocks until it is done.
+    void onStarted(int64_t durationNs);
+
+    // State kept across restarts of the lazy service. A warm start restored the state of a
+    // previous instance in the same boot.
+    bool isWarmStart() const { return mWarmStart; }
+    void recordUnlock(bool success);
+    // First sign of the user reaching for the sensor, the start of the wake to unlock latency.
+    // Later calls are ignored until the operation finishes.
+    void markWake(int64_t timeNs);
+    // Authenticator IDs are cached per user until the user's enrollments change.
+    void onAuthenticatorId(int64_t id);
+    void onEnrollmentsChanged();
+
     virtual ndk::ScopedAStatus onPointerDownImpl(int32_t pointerId, int32_t x, int32_t y,
                                                  float minor, float major);
 
     virtual ndk::ScopedAStatus onPointerUpImpl(int32_t pointerId);
+    // Pointer up for a capture the vendor ended, from the notify thread. The touch state is only
+    // touched on the worker, so it goes there like any other pointer up.
+    void postPointerUp();
 
     virtual ndk::ScopedAStatus onUiReadyImpl();
 
     virtual SensorLocation getSensorLocation();
-  
+
+    virtual std::string toString() const;
+
   protected:
     ISessionCallback* mCb;
 
@@ -74,30 +200,186 @@ class FingerprintEngine {
     static constexpr int32_t FINGERPRINT_ERROR_VENDOR_BASE = 1000;
     void clearLockout(ISessionCallback* cb, bool dueToTimeout = false);
     void waitForFingerDown(ISessionCallback* cb, const std::future<void>& cancel);
+    // Starts the finger down sequence for an early down, unless another one is in progress.
+    bool beginEarlyDown(int32_t slot, int32_t x, int32_t y);
+
+    fingerprint_device_t* openFingerprintHal(const hw_module_t* hw_mdl);
+    // Loads the library of a "class[:module_id]" entry of kModules, without opening a device.
+    static const hw_module_t* loadModule(const std::string& module);
+    // Opens the device of an entry of kModules, loading it first unless hw_mdl is given.
+    fingerprint_device_t* openModule(const std::string& module,
+                                     const hw_module_t* hw_mdl = nullptr);
+    fingerprint_device_t* probeModules(const std::string& skip, std::string* opened);
 
-    fingerprint_device_t* openFingerprintHal(const char* class_name,
-                                                        const char* module_id);
+    // Runs a call into the vendor device under mWatchdog, on the worker. On a worker thread
+    // that was abandoned it fails without calling the device.
+    template <typename Call>
+    auto watched(const char* name, Call&& call);
+    // Runs on the watchdog thread: fails whatever waits for the device and moves the worker to
+    // a fresh thread that reopens it. A call stuck anywhere but on the worker can't be given up
+    // on and restarts the service.
+    void onDeviceHang(const char* call, int64_t startNs, std::thread::id caller);
+    void recoverDevice(int64_t hangStartNs, uint32_t attempt);
 
-    template <typename T>
-    void set(const std::string &path, const T &value);
-    void setFodStatus(int value);
+    // Feeds the FOD state machine on the worker, posting the event there from other threads.
+    // Dropped on an abandoned worker thread, the machine belongs to the new one.
+    void dispatchFod(FodEvent event, int32_t x = 0, int32_t y = 0);
+    FodStateMachine& fod() { return *mFod.load(std::memory_order_acquire); }
+    const FodStateMachine& fod() const { return *mFod.load(std::memory_order_acquire); }
+
+    // FodActuator, only called by fod().
+    void setFodStatus(bool on) override;
+    void setPressCoordinates(int32_t x, int32_t y) override;
+    void setPressStatus(bool pressed) override;
+    void setLocalHbm(bool on) override;
+    void beginLocalHbm() override;
+    void finishLocalHbm() override;
+    void cancelLocalHbm() override;
 
     fingerprint_device_t* mDevice;
-    void setFingerStatus(bool pressed);
+    // Callback for the next device opened, a new generation after each hang.
+    fingerprint_notify_t mNotify;
+    SysfsNode mFodStatusNode;
+    SysfsNode mDispParamNode;
+    IlluminationThread mIllumination;
+    // Replaced on recovery since a call stuck in the device may hold the lock of the old one.
+    // Old machines are kept, an abandoned thread may still return into its machine.
+    std::atomic<FodStateMachine*> mFod;
+    std::vector<std::unique_ptr<FodStateMachine>> mFodMachines;
 
   protected:
+    // A timer whose pending action is discarded once the slot is re-armed or cancelled, even if
+    // it already fired and is waiting in the worker queue.
+    struct TimerSlot {
+        TimerService::TimerId id = TimerService::kInvalidTimer;
+        uint64_t seq = 0;
+    };
+
+    // Vendor calls shared with the type specific engines.
+    int deviceAuthenticate(int64_t operationId);
+    void deviceCancel();
+    // Cancels what runs in the vendor device on behalf of op, which is not the framework's
+    // running operation anymore, and waits up to kPreemptTimeoutMs for the CANCELED
+    // interceptNotify() drops. Runs on the worker.
+    void cancelInDevice(uint64_t op);
+
+    void armOperationDeadline(int64_t timeoutMs);
+    // Applies the persist.vendor.fingerprint.boost.* policy, or extends it, until the operation
+    // finishes or kBoostTimeoutMs pass.
+    void boostOperation();
+    void endBoost();
+    void armTimer(TimerSlot* slot, int64_t delayMs, WorkScheduler::TaskKind kind,
+                  std::function<void()> action);
+    void cancelTimer(TimerSlot* slot);
+
+    WorkScheduler* mWorker;
+    TimerService* mTimers;
+    mutable std::mutex mTimerLock;
+    TimerSlot mUiReadyTimer;
+    TimerSlot mHbmSafetyTimer;
+    TimerSlot mOperationTimer;
+    TimerSlot mBoostTimer;
+    bool mOperationTimedOut;
+    uint64_t mUiReadyTimeouts;
+    uint64_t mHbmSafetyTimeouts;
+    uint64_t mOperationTimeouts;
+    uint64_t mBoostTimeouts;
+
+    // operation tracking
+    mutable std::mutex mOperationLock;
+    uint64_t mQueuedOperation;
+    const char* mQueuedOperationName;
+    bool mQueuedOperationStarted;
+    uint64_t mRunningOperation;
+    const char* mRunningOperationName;
+    // Whether mRunningOperation has a vendor operation behind it, detectInteraction does not.
+    bool mRunningInDevice;
+    // Preempted operation whose CANCELED is still expected, 0 if none.
+    uint64_t mPreemptedOperation;
+    std::condition_variable mPreemptedCond;
+    int64_t mCancelStartNs;
+    uint64_t mCancelRequests;
+    uint64_t mPreemptions;
+    uint64_t mPreemptTimeouts;
+    uint64_t mStaleOperations;
+    LatencyHistogram mCancelToIdle;
+
     // lockout timer
     void lockoutTimerExpired(ISessionCallback* cb);
     bool isLockoutTimerSupported;
-    bool isLockoutTimerStarted;
-    bool isLockoutTimerAborted;
+    TimerSlot mLockoutTimer;
+
+    // user whose templates are loaded in the vendor device, -1 if none
+    int mActiveGroup;
+    uint64_t mActiveGroupLoads;
+    uint64_t mActiveGroupSkips;
+
+    std::array<std::atomic<uint64_t>, static_cast<size_t>(HitTestResult::kCount)> mHitTests{};
+
+    // early finger down from the touch node
+    std::unique_ptr<TouchInputReader> mTouchReader;
+    std::atomic<int32_t> mTouchSlot;
+    // Only used on the worker.
+    int64_t mTouchHbmNs;
+    std::atomic<uint64_t> mTouchDowns;
+    std::atomic<uint64_t> mTouchDeduped;
+    LatencyHistogram mTouchLead;
+
+    // early finger down from fod_press_status
+    std::unique_ptr<FodPressWatcher> mPressWatcher;
+    std::atomic<int64_t> mPressNs;
+    std::atomic<uint64_t> mPressDowns;
+    // From the press notification to the press command going to the vendor.
+    LatencyHistogram mPressToCapture;
+
+    std::atomic<int64_t> mWakeNs;
+    LatencyHistogram mWakeToUnlock;
+
+    // vendor module discovery
+    std::string mModule;
+    int64_t mProbeTimeNs;
+    bool mProbeCached;
+
+    SchedBoost mBoost;
+
+    StateSnapshot mSnapshot;
+    bool mWarmStart;
+    uint64_t mCachedAuthenticatorIds;
+
+    // second start-up phase
+    void waitForData();
+    void dataThreadFunc();
+    mutable std::mutex mDataLock;
+    std::condition_variable mDataCond;
+    bool mDataReady;
+    bool mIsDestructing;
+    std::thread mDataThread;
+    int64_t mStartupNs;
+    // CLOCK_BOOTTIME at: service ready, /data ready, first user's templates loaded.
+    int64_t mHalReadyBootNs;
+    int64_t mDataReadyBootNs;
+    std::atomic<int64_t> mFirstGroupBootNs;
+
+    // vendor device recovery, guarded by mRecoveryLock
+    mutable std::mutex mRecoveryLock;
+    uint32_t mRecentHangs;
+    int64_t mLastHangNs;
+    uint64_t mRecoveries;
+    // Reopen attempts that failed, each one retried through mRecoveryTimer.
+    uint64_t mRecoveryFailures;
+    TimerSlot mRecoveryTimer;
+    // From the start of the hung call until the reopened device is ready.
+    LatencyHistogram mRecoveryTime;
+    // Declared after everything its hang handler touches.
+    DeviceWatchdog mWatchdog;
 
   public:
     void startLockoutTimer(int64_t timeout, ISessionCallback* cb);
-    bool getLockoutTimerStarted() { return isLockoutTimerStarted; };
+    bool getLockoutTimerStarted();
 
     LockoutTracker mLockoutTracker;
-    void onAcquired(int32_t result, int32_t vendorCode);
+    FingerprintMetrics mMetrics;
+    virtual void onAcquired(int32_t result, int32_t vendorCode);
     std::pair<AcquiredInfo, int32_t> convertAcquiredInfo(int32_t code);
     std::pair<Error, int32_t> convertError(int32_t code);
     bool checkSensorLockout(ISessionCallback*);
@@ -21,10 +21,14 @@ using namespace ::aidl::android::hardware::biometrics::common;
 
 namespace aidl::android::hardware::biometrics::fingerprint {
 
-class FingerprintEngineRear : public FingerprintEngine {
+// Rear sensor: no display involvement, the finger landing on the sensor is the wakeup.
+class FingerprintEngineRear FINGERPRINT_REAR_FINAL : public FingerprintEngine {
   public:
     FingerprintEngineRear() : FingerprintEngine() {}
     ~FingerprintEngineRear() {}
+
+    const char* typeName() const override { return "rear"; }
+    void onAcquired(int32_t result, int32_t vendorCode) override;
 };
 
 }  // namespace aidl::android::hardware::biometrics::fingerprint
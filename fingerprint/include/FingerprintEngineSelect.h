@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+// Engine the service is built around. With the PERIDOT_FINGERPRINT sensor_type Soong variable
+// set, the engine class is fixed and final: the service and its sessions hold it by its own
+// type, so every call into it is direct and can be inlined, and the other engines are not
+// built. Without it the engine is picked from persist.vendor.fingerprint.type on start-up.
+
+#if defined(FINGERPRINT_SENSOR_TYPE_SIDE) || defined(FINGERPRINT_SENSOR_TYPE_REAR) || \
+        defined(FINGERPRINT_SENSOR_TYPE_UDFPS) || defined(FINGERPRINT_SENSOR_TYPE_UDFPS_US)
+#define FINGERPRINT_ENGINE_FIXED 1
+#endif
+
+#if defined(FINGERPRINT_SENSOR_TYPE_SIDE)
+#include "FingerprintEngineSide.h"
+#elif defined(FINGERPRINT_SENSOR_TYPE_REAR)
+#include "FingerprintEngineRear.h"
+#else
+#include "FingerprintEngine.h"
+#endif
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+#if defined(FINGERPRINT_SENSOR_TYPE_SIDE)
+using Engine = FingerprintEngineSide;
+constexpr char kFixedSensorType[] = "side";
+#elif defined(FINGERPRINT_SENSOR_TYPE_REAR)
+using Engine = FingerprintEngineRear;
+constexpr char kFixedSensorType[] = "rear";
+#elif defined(FINGERPRINT_SENSOR_TYPE_UDFPS)
+using Engine = FingerprintEngine;
+constexpr char kFixedSensorType[] = "udfps";
+#elif defined(FINGERPRINT_SENSOR_TYPE_UDFPS_US)
+using Engine = FingerprintEngine;
+constexpr char kFixedSensorType[] = "udfps_us";
+#else
+using Engine = FingerprintEngine;
+#endif
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
@@ -15,22 +15,75 @@
  */
 
 #pragma once
+#include <android-base/unique_fd.h>
+
 #include "FingerprintEngine.h"
+#include "KeyInputReader.h"
 
 using namespace ::aidl::android::hardware::biometrics::common;
 
 namespace aidl::android::hardware::biometrics::fingerprint {
 
-class FingerprintEngineSide : public FingerprintEngine {
+// Power button sensor. The finger that presses the power key is already on the sensor, so with
+// persist.vendor.fingerprint.side.power_key_device set a press that wakes the display starts a
+// vendor authenticate right away, while the display is still powering up. Its results are held
+// back until keyguard's own authenticate arrives: a capture still running is adopted as that
+// operation and a match already made is replayed to it. Without one in time, or once a press
+// turns the display off again, it is dropped.
+class FingerprintEngineSide FINGERPRINT_SIDE_FINAL : public FingerprintEngine {
   public:
     static constexpr int32_t defaultSensorLocationX = 0;
     static constexpr int32_t defaultSensorLocationY = 600;
     static constexpr int32_t defaultSensorRadius = 150;
+    // How long an authenticate started by the power key waits for the framework's.
+    static constexpr int64_t kSpeculationTimeoutMs = 2000;
+    // Operation the base class is told it cancels for a speculation, no framework ID is that.
+    static constexpr uint64_t kSpeculativeOperation = UINT64_MAX;
+    static constexpr const char* kBrightnessPath =
+            "/sys/class/backlight/panel0-backlight/brightness";
 
     FingerprintEngineSide();
     ~FingerprintEngineSide() {}
 
-    virtual SensorLocation defaultSensorLocation() override;
+    void attach(WorkScheduler* worker, TimerService* timers) override;
+    const char* typeName() const override { return "side"; }
+    bool interceptNotify(const fingerprint_msg_t& msg) override;
+    void onAcquired(int32_t result, int32_t vendorCode) override;
+    void authenticateImpl(ISessionCallback* cb, int64_t operationId,
+                          const std::future<void>& cancel) override;
+    SensorLocation getSensorLocation() override;
+    std::string toString() const override;
+
+  private:
+    enum class Speculation : uint8_t {
+        kIdle = 0,
+        // Vendor authenticating for a key press, its messages are held back.
+        kRunning,
+        // Vendor matched, the result waits for the framework's authenticate.
+        kMatched,
+    };
+
+    SensorLocation defaultSensorLocation();
+    void onPowerKey(int64_t timeNs);
+    void speculate();
+    void expireSpeculation();
+    // Cancels a capture still running and forgets a held match. Returns false without either.
+    bool dropSpeculation();
+    bool isDisplayOn();
+
+    std::unique_ptr<KeyInputReader> mPowerKey;
+    ::android::base::unique_fd mBrightnessFd;
+
+    mutable std::mutex mSpeculationLock;
+    Speculation mSpeculation;
+    fingerprint_msg_t mHeldMatch;
+    uint64_t mSpeculations;
+    uint64_t mAdopted;
+    uint64_t mReplayed;
+    uint64_t mExpired;
+    uint64_t mDisplayOff;
+    uint64_t mHeldFailures;
+    TimerSlot mSpeculationTimer;
 };
 
 }  // namespace aidl::android::hardware::biometrics::fingerprint
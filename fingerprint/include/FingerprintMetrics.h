@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+// Keeps the most recent latency samples and reduces them to percentiles on demand.
+class LatencyHistogram {
+  public:
+    void record(int64_t durationNs);
+    uint64_t count() const;
+    std::string toString() const;
+
+  private:
+    static constexpr size_t kWindowSize = 256;
+
+    mutable std::mutex mLock;
+    std::array<int64_t, kWindowSize> mSamples{};
+    size_t mNext = 0;
+    uint64_t mCount = 0;
+    int64_t mMax = 0;
+};
+
+// Timestamps each stage of an UDFPS unlock and aggregates the time spent between stages.
+class FingerprintMetrics {
+  public:
+    enum class Stage : uint8_t {
+        kPointerDown = 0,  // Session::onPointerDown, binder thread
+        kEngineDown,       // FingerprintEngine::onPointerDownImpl, worker thread
+        kLocalHbm,         // DISP_PARAM_PATH local HBM write done
+        kPressCmd,         // goodixExtCmd press/NIT commands issued, after local HBM
+        kFirstAcquired,    // first FINGERPRINT_ACQUIRED from the vendor
+        kAuthenticated,    // FINGERPRINT_AUTHENTICATED from the vendor
+        kCount,
+    };
+
+    void beginUnlock();
+    void mark(Stage stage);
+    void endUnlock(bool success);
+    // Whether a scheduler boost is active. Unlocks that saw one at any point are aggregated
+    // separately.
+    void setBoosted(bool boosted);
+
+    std::string toString() const;
+
+  private:
+    static constexpr size_t kStageCount = static_cast<size_t>(Stage::kCount);
+    static const char* stageName(size_t stage);
+
+    mutable std::mutex mLock;
+    bool mActive = false;
+    bool mBoosted = false;
+    bool mUnlockBoosted = false;
+    std::array<int64_t, kStageCount> mStamps{};
+
+    // Indexed by [boosted][success][stage]; stage N holds the time between stage N-1 and N,
+    // stage 0 holds the end-to-end time.
+    std::array<std::array<std::array<LatencyHistogram, kStageCount>, 2>, 2> mHistograms;
+};
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#ifndef ATRACE_TAG
+#define ATRACE_TAG ATRACE_TAG_HAL
+#endif
+
+#include <cutils/trace.h>
+
+#include <cstdint>
+
+#include "fingerprint-xiaomi.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+// atrace section covering the enclosing scope. Shows up in Perfetto under the "hal" category,
+// next to the input and SurfaceFlinger tracks of the same unlock.
+class ScopedTrace {
+  public:
+    explicit ScopedTrace(const char* name) { ATRACE_BEGIN(name); }
+    ~ScopedTrace() { ATRACE_END(); }
+
+    ScopedTrace(const ScopedTrace&) = delete;
+    ScopedTrace& operator=(const ScopedTrace&) = delete;
+};
+
+// Counter tracks.
+constexpr char kTraceHbm[] = "FpLocalHbm";
+constexpr char kTraceLockout[] = "FpLockoutMode";
+constexpr char kTraceQueueNormal[] = "FpQueueNormal";
+constexpr char kTraceQueueHigh[] = "FpQueueHigh";
+
+constexpr const char* traceName(fingerprint_msg_type_t type) {
+    switch (type) {
+        case FINGERPRINT_ERROR:
+            return "FpError";
+        case FINGERPRINT_ACQUIRED:
+            return "FpAcquired";
+        case FINGERPRINT_TEMPLATE_ENROLLING:
+            return "FpEnrolling";
+        case FINGERPRINT_TEMPLATE_REMOVED:
+            return "FpRemoved";
+        case FINGERPRINT_AUTHENTICATED:
+            return "FpAuthenticated";
+        case FINGERPRINT_TEMPLATE_ENUMERATING:
+            return "FpEnumerating";
+        case FINGERPRINT_CHALLENGE_GENERATED:
+            return "FpChallengeGenerated";
+        case FINGERPRINT_CHALLENGE_REVOKED:
+            return "FpChallengeRevoked";
+        case FINGERPRINT_AUTHENTICATOR_ID_RETRIEVED:
+            return "FpAuthenticatorIdRetrieved";
+        case FINGERPRINT_AUTHENTICATOR_ID_INVALIDATED:
+            return "FpAuthenticatorIdInvalidated";
+        case FINGERPRINT_RESET_LOCKOUT:
+            return "FpResetLockout";
+    }
+    return "FpUnknown";
+}
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
+
+#define FP_TRACE_CONCAT_(a, b) a##b
+#define FP_TRACE_CONCAT(a, b) FP_TRACE_CONCAT_(a, b)
+#define FP_TRACE_NAME(name)                                         \
+    ::aidl::android::hardware::biometrics::fingerprint::ScopedTrace \
+            FP_TRACE_CONCAT(fpTrace_, __LINE__)(name)
+#define FP_TRACE_CALL() FP_TRACE_NAME(__func__)
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <android-base/unique_fd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+// Waits in poll() for the touch driver's sysfs_notify() on fod_press_status and reports a finger
+// pressing or leaving the sensor area. The touch IC keeps scanning the sensor area while the
+// display is off or in AOD, so this is the earliest finger down the HAL can see there, well
+// before the framework is awake to send onPointerDown. Timestamps are CLOCK_MONOTONIC
+// nanoseconds of the wakeup.
+//
+// The HAL arms and disarms the sensor through the same node, and the driver notifies for those
+// writes too. A change to the value the HAL wrote last, within kOwnWriteWindowMs of the write, is
+// taken as that write and not reported.
+class FodPressWatcher {
+  public:
+    // Runs on the watcher thread.
+    using Handler = std::function<void(bool pressed, int64_t timeNs)>;
+
+    static constexpr int64_t kOwnWriteWindowMs = 100;
+
+    explicit FodPressWatcher(Handler handler);
+    ~FodPressWatcher();
+
+    FodPressWatcher(const FodPressWatcher&) = delete;
+    FodPressWatcher& operator=(const FodPressWatcher&) = delete;
+
+    bool start(const char* path);
+
+    // Called by the HAL right before it writes value to the node itself, from any thread.
+    void noteHalWrite(int value);
+
+    std::string toString() const;
+
+  private:
+    void threadFunc();
+    // Reads the node back, which also re-arms the notification. -1 on error.
+    int readValue();
+    // Whether value comes from the last noteHalWrite(), which is then consumed.
+    bool isHalWrite(int value, int64_t timeNs);
+
+    Handler mHandler;
+    std::string mPath;
+    // Only touched by the watcher thread.
+    int mLast;
+
+    std::mutex mHalWriteLock;
+    int mHalValue;
+    // 0 once consumed.
+    int64_t mHalWriteNs;
+
+    std::atomic<uint64_t> mNotifications{0};
+    std::atomic<uint64_t> mPresses{0};
+    std::atomic<uint64_t> mReleases{0};
+    std::atomic<uint64_t> mUnchanged{0};
+    std::atomic<uint64_t> mHalWrites{0};
+
+    ::android::base::unique_fd mFd;
+    ::android::base::unique_fd mStopFd;
+    std::thread mThread;
+};
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
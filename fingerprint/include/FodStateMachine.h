@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "FingerprintMetrics.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+enum class FodState : uint8_t {
+    kIdle = 0,
+    // The vendor waits for a finger, fod_press_status is on.
+    kArmed,
+    // Panel lit and the finger reported to the vendor.
+    kIlluminated,
+    // Image taken, press released towards the vendor, waiting for the match.
+    kCapturing,
+    // Image accepted, everything is off until the finger is lifted.
+    kDone,
+    kCount,
+};
+
+enum class FodEvent : uint8_t {
+    // Vendor acquired codes 21 (authenticate) and 23 (enroll).
+    kWaitingForFinger = 0,
+    kFingerDown,
+    // Any non-vendor acquired info but GOOD.
+    kAcquired,
+    kAcquiredGood,
+    // Vendor acquired code 44.
+    kScanFailed,
+    kFingerUp,
+    // Operation over or cancelled.
+    kReset,
+    kCount,
+};
+
+// Hardware controls driven by the state machine.
+class FodActuator {
+  public:
+    virtual ~FodActuator() = default;
+    virtual void setFodStatus(bool on) = 0;
+    virtual void setPressCoordinates(int32_t x, int32_t y) = 0;
+    virtual void setPressStatus(bool pressed) = 0;
+    virtual void setLocalHbm(bool on) = 0;
+    // Turning local HBM on may run concurrently with the press coordinates: beginLocalHbm()
+    // starts it, finishLocalHbm() waits for it. Synchronous by default.
+    virtual void beginLocalHbm() { setLocalHbm(true); }
+    virtual void finishLocalHbm() {}
+    // Called before local HBM is turned off: drops a ramp that has not started and waits for
+    // one in progress, however long it takes, so it can't turn the panel back on afterwards.
+    virtual void cancelLocalHbm() {}
+};
+
+// Single owner of fod_press_status, the vendor press commands and local HBM. Every state has a
+// fixed set of outputs and a transition only touches the outputs that differ between its two
+// states, so repeated or no-op events do no I/O at all. Both tables are built at compile time.
+class FodStateMachine {
+  public:
+    enum Output : uint8_t {
+        kFodStatus = 1 << 0,
+        kCoordinates = 1 << 1,
+        kPressStatus = 1 << 2,
+        kLocalHbm = 1 << 3,
+    };
+
+    static constexpr size_t kStates = static_cast<size_t>(FodState::kCount);
+    static constexpr size_t kEvents = static_cast<size_t>(FodEvent::kCount);
+
+    // Outputs that are on in each state.
+    static constexpr std::array<uint8_t, kStates> kStateOutputs = {
+            /* kIdle */ 0,
+            /* kArmed */ kFodStatus,
+            /* kIlluminated */ kFodStatus | kCoordinates | kPressStatus | kLocalHbm,
+            /* kCapturing */ kFodStatus,
+            /* kDone */ 0,
+    };
+
+    static constexpr FodState next(FodState state, FodEvent event) {
+        return kTransitions[static_cast<size_t>(state)][static_cast<size_t>(event)];
+    }
+
+    // Outputs a transition has to write.
+    static constexpr uint8_t actions(FodState from, FodState to) {
+        return kStateOutputs[static_cast<size_t>(from)] ^ kStateOutputs[static_cast<size_t>(to)];
+    }
+
+    explicit FodStateMachine(FodActuator* actuator);
+
+    FodStateMachine(const FodStateMachine&) = delete;
+    FodStateMachine& operator=(const FodStateMachine&) = delete;
+
+    // Coordinates are only used by kFingerDown. Returns the new state.
+    FodState dispatch(FodEvent event, int32_t x = 0, int32_t y = 0);
+
+    FodState state() const;
+
+    std::string toString() const;
+
+  private:
+    using S = FodState;
+    // Rows are states, columns events in FodEvent order: WaitingForFinger, FingerDown,
+    // Acquired, AcquiredGood, ScanFailed, FingerUp, Reset.
+    static constexpr std::array<std::array<FodState, kEvents>, kStates> kTransitions = {{
+            /* kIdle */
+            {S::kArmed, S::kIlluminated, S::kIdle, S::kIdle, S::kIdle, S::kIdle, S::kIdle},
+            /* kArmed */
+            {S::kArmed, S::kIlluminated, S::kArmed, S::kDone, S::kArmed, S::kArmed, S::kIdle},
+            /* kIlluminated */
+            {S::kIlluminated, S::kIlluminated, S::kCapturing, S::kDone, S::kArmed, S::kArmed,
+             S::kIdle},
+            /* kCapturing */
+            {S::kArmed, S::kIlluminated, S::kCapturing, S::kDone, S::kArmed, S::kArmed, S::kIdle},
+            /* kDone */
+            {S::kArmed, S::kIlluminated, S::kDone, S::kDone, S::kDone, S::kIdle, S::kIdle},
+    }};
+
+    FodActuator* const mActuator;
+    mutable std::mutex mLock;
+    FodState mState;
+
+    // Guarded by mLock.
+    uint64_t mTransitions;
+    uint64_t mNoops;
+    std::array<uint64_t, 4> mWrites{};
+
+    // Finger down: coordinates sent while the panel ramps, and the whole transition.
+    LatencyHistogram mArmTime;
+    LatencyHistogram mFingerDownTime;
+};
+
+// Invariants of the tables, checked at compile time.
+namespace fod_checks {
+
+using M = FodStateMachine;
+
+constexpr bool forAllStates(bool (*predicate)(FodState)) {
+    for (size_t s = 0; s < M::kStates; s++) {
+        if (!predicate(static_cast<FodState>(s))) return false;
+    }
+    return true;
+}
+
+constexpr uint8_t outputsAfter(FodState state, FodEvent event) {
+    return M::kStateOutputs[static_cast<size_t>(M::next(state, event))];
+}
+
+static_assert(forAllStates([](FodState s) {
+                  return M::next(s, FodEvent::kReset) == FodState::kIdle;
+              }),
+              "reset must always end in idle");
+static_assert(forAllStates([](FodState s) {
+                  return (outputsAfter(s, FodEvent::kFingerUp) &
+                          (M::kLocalHbm | M::kPressStatus)) == 0;
+              }),
+              "lifting the finger must release the press and turn off local HBM");
+static_assert(forAllStates([](FodState s) {
+                  uint8_t outputs = M::kStateOutputs[static_cast<size_t>(s)];
+                  return !(outputs & M::kLocalHbm) || (outputs & M::kPressStatus);
+              }),
+              "local HBM is only on for a pressed finger");
+static_assert(forAllStates([](FodState s) {
+                  return (outputsAfter(s, FodEvent::kFingerDown) & M::kLocalHbm) != 0;
+              }),
+              "a finger down always ends with the panel lit");
+static_assert(M::actions(FodState::kDone, FodState::kIdle) == 0,
+              "idle after done must not do any I/O");
+
+}  // namespace fod_checks
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "FingerprintMetrics.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+// Persistent thread that ramps the panel's local HBM while the worker thread keeps arming the
+// sensor. It runs one job at a time; wait() is the barrier the worker blocks on before it lets
+// the vendor capture.
+class IlluminationThread {
+  public:
+    IlluminationThread();
+    ~IlluminationThread();
+
+    IlluminationThread(const IlluminationThread&) = delete;
+    IlluminationThread& operator=(const IlluminationThread&) = delete;
+
+    // Hands the job over and returns right away. A job that has not started yet is replaced.
+    void start(std::function<void()> job);
+
+    // Blocks until every started job has finished. Returns false on timeout, the job still
+    // runs afterwards.
+    bool wait(int64_t timeoutMs);
+
+    // Drops a job that has not started yet and blocks until a running one has finished, for at
+    // most timeoutMs. Returns false on timeout: the job is stuck, in a sysfs write most likely,
+    // and undo runs on this thread once it finishes, unless a new job was started meanwhile.
+    bool cancel(int64_t timeoutMs, std::function<void()> undo);
+    // Whether the undo of a job stuck past cancel() is still to run.
+    bool isUndoPending() const;
+
+    std::string toString() const;
+
+  private:
+    void threadFunc();
+
+    mutable std::mutex mLock;
+    std::condition_variable mCond;
+    std::function<void()> mJob;
+    // Reverts a job that outlived cancel().
+    std::function<void()> mUndo;
+    int64_t mStartNs;
+    uint64_t mStarted;
+    uint64_t mFinished;
+    bool mIsDestructing;
+
+    uint64_t mReplaced;
+    uint64_t mCancelled;
+    uint64_t mTimeouts;
+    // Hand-over to the thread, time spent in the job, and time the worker spent in wait().
+    LatencyHistogram mWakeup;
+    LatencyHistogram mRunTime;
+    LatencyHistogram mWaitTime;
+
+    std::thread mThread;
+};
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <android-base/unique_fd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+// Reports presses of one key of an evdev node on its own epoll thread, ahead of the framework's
+// input pipeline. Timestamps are CLOCK_MONOTONIC nanoseconds of the kernel event.
+class KeyInputReader {
+  public:
+    // Runs on the reader thread.
+    using Handler = std::function<void(int64_t timeNs)>;
+
+    KeyInputReader(uint16_t code, Handler onPress);
+    ~KeyInputReader();
+
+    KeyInputReader(const KeyInputReader&) = delete;
+    KeyInputReader& operator=(const KeyInputReader&) = delete;
+
+    bool start(const std::string& path);
+
+    std::string toString() const;
+
+  private:
+    void threadFunc();
+
+    const uint16_t mCode;
+    Handler mOnPress;
+    std::string mPath;
+
+    std::atomic<uint64_t> mPresses{0};
+
+    ::android::base::unique_fd mInputFd;
+    ::android::base::unique_fd mEpollFd;
+    ::android::base::unique_fd mStopFd;
+    std::thread mThread;
+};
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
@@ -25,6 +25,7 @@ inline void translate(const ::aidl::android::hardware::keymaster::HardwareAuthTo
     std::copy(authToken.mac.begin(), authToken.mac.end(), hat.hmac);
 }
 
+// Overwrites authToken in place: the mac keeps its buffer when the token is reused.
 inline void translate(const hw_auth_token_t& hat,
                       ::aidl::android::hardware::keymaster::HardwareAuthToken& authToken) {
     authToken.challenge = hat.challenge;
@@ -35,7 +36,7 @@ inline void translate(const hw_auth_token_t& hat,
             static_cast<::aidl::android::hardware::keymaster::HardwareAuthenticatorType>(
                     be32toh(hat.authenticator_type));
     authToken.timestamp.milliSeconds = be64toh(hat.timestamp);
-    authToken.mac.insert(authToken.mac.begin(), std::begin(hat.hmac), std::end(hat.hmac));
+    authToken.mac.assign(std::begin(hat.hmac), std::end(hat.hmac));
 }
 
 }  // namespace aidl::android::hardware::biometrics::fingerprint
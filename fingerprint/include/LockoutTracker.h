@@ -18,17 +18,24 @@
 
 #include <android/binder_to_string.h>
 #include <stdint.h>
+#include <mutex>
 #include <string>
 
+#include "StateSnapshot.h"
+
 #define LOCKOUT_TIMED_THRESHOLD 5
 #define LOCKOUT_TIMED_DURATION 10000
 #define LOCKOUT_PERMANENT_THRESHOLD 20
 
 namespace aidl::android::hardware::biometrics::fingerprint {
 
+// Called from the worker, the notify thread and the data thread, so every member is guarded by
+// mLock.
 class LockoutTracker {
   public:
-    LockoutTracker() : mFailedCount(0) {}
+    LockoutTracker()
+        : mFailedCount(0), mLockoutTimedStart(0), mCurrentMode(LockoutMode::kNone),
+          mSnapshot(nullptr) {}
     ~LockoutTracker() {}
 
     enum class LockoutMode : int8_t { kNone = 0, kTimed, kPermanent };
@@ -38,10 +45,18 @@ class LockoutTracker {
     void addFailedAttempt();
     int64_t getLockoutTimeLeft();
 
+    // Restores the counters from the snapshot and keeps it up to date from now on.
+    void attach(StateSnapshot* snapshot);
+
   private:
+    void persistLocked();
+
+    std::mutex mLock;
+
     int32_t mFailedCount;
     int64_t mLockoutTimedStart;
     LockoutMode mCurrentMode;
+    StateSnapshot* mSnapshot;
 };
 
 }  // namespace aidl::android::hardware::biometrics::fingerprint
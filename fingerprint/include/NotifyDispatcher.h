@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <android-base/unique_fd.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "fingerprint-xiaomi.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+// Moves fingerprint_msg_t notifications off the vendor callback thread. The vendor thread copies
+// the message into a bounded ring and returns; a dedicated dispatcher thread drains the ring and
+// runs the handler, which may block on binder. The ring takes several producers without a lock:
+// the vendor threads of the current and of replaced devices, and the HAL's own inject(). Each
+// producer claims a slot with a CAS on the tail and publishes it with the slot's sequence number,
+// so messages are delivered in the order their slots were claimed.
+//
+// Overflow policy: vendor FINGERPRINT_ACQUIRED codes are progress hints and are dropped once the
+// ring is kReserved slots short of full, except the ones the FOD state machine acts on. Every
+// other message ends or advances an operation (AUTHENTICATED, TEMPLATE_ENROLLING, ERROR, ...) and
+// must never be lost: it may use the reserved slots, and if even those are taken it goes to a
+// spill list under mSpillLock. While the spill list is non-empty all new messages follow it,
+// preserving delivery order. Only that backlog, which the reserve keeps out of normal operation,
+// ever takes a lock or allocates on the vendor thread.
+//
+// A vendor device replaced by a recovery may keep calling back from threads of its own. Each
+// device gets the callback of a generation of its own, and messages posted for any other are
+// dropped, both when posted and when delivered.
+class NotifyDispatcher {
+  public:
+    using Handler = std::function<void(const fingerprint_msg_t& msg)>;
+    // Vendor devices a process can open. Generations are never reused: a hung device is never
+    // closed and may call back at any time.
+    static constexpr uint32_t kGenerations = 32;
+
+    explicit NotifyDispatcher(Handler handler);
+    ~NotifyDispatcher();
+
+    NotifyDispatcher(const NotifyDispatcher&) = delete;
+    NotifyDispatcher& operator=(const NotifyDispatcher&) = delete;
+
+    // Producer side, called on the vendor callback thread. generation is the one nextGeneration()
+    // returned when the device was opened.
+    void post(const fingerprint_msg_t* msg, uint32_t generation);
+    // Messages made up by the HAL itself, from any thread.
+    void inject(const fingerprint_msg_t& msg);
+    // Starts the generation of a newly opened device and returns it, below kGenerations. Once it
+    // returns, nothing posted for an older device is delivered anymore.
+    uint32_t nextGeneration();
+
+    std::string toString() const;
+
+  private:
+    static constexpr size_t kCapacity = 64;
+    static_assert((kCapacity & (kCapacity - 1)) == 0, "capacity must be a power of two");
+    // Slots only messages that must not be lost may take.
+    static constexpr size_t kReserved = 16;
+    // Generation of injected messages, delivered whatever device is current.
+    static constexpr uint32_t kAnyGeneration = UINT32_MAX;
+
+    struct Entry {
+        fingerprint_msg_t msg;
+        uint32_t generation;
+    };
+    struct Slot {
+        // Equals the position of the slot while it is free to write, position + 1 once the
+        // entry is published, and position + kCapacity once the dispatcher consumed it.
+        std::atomic<size_t> sequence;
+        Entry entry;
+    };
+
+    static bool isLossless(const fingerprint_msg_t& msg);
+
+    void push(const fingerprint_msg_t& msg, uint32_t generation);
+    // Claims and fills a ring slot, false if the ring has no room for msg.
+    bool tryPush(const Entry& entry, bool lossless);
+    bool isCurrent(uint32_t generation) const;
+    void deliver(const Entry& entry);
+    // Delivers the published ring entries, on the dispatcher thread.
+    void drainRing();
+    void wake();
+    void threadFunc();
+
+    Handler mHandler;
+
+    std::array<Slot, kCapacity> mRing;
+    alignas(64) std::atomic<size_t> mHead{0};  // next slot to read, owned by the dispatcher
+    alignas(64) std::atomic<size_t> mTail{0};  // next slot to claim, shared by the producers
+
+    std::atomic<uint32_t> mGeneration{0};
+
+    std::mutex mSpillLock;
+    std::deque<Entry> mSpill;
+    std::atomic<bool> mSpillPending{false};
+
+    std::atomic<uint64_t> mPosted{0};
+    std::atomic<uint64_t> mDropped{0};
+    std::atomic<uint64_t> mSpilled{0};
+    std::atomic<uint64_t> mStale{0};
+    std::atomic<size_t> mHighWater{0};
+
+    std::atomic<bool> mStop{false};
+    ::android::base::unique_fd mEventFd;
+    std::thread mThread;
+};
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
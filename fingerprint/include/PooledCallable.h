@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "thread/Callable.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+// Fixed set of blocks that worker tasks posted from the notify path are built in, so a vendor
+// message does not cost a heap allocation to reach the worker. Blocks are claimed and returned
+// with a CAS on a bitmask; when all are in use, or a task does not fit, it falls back to the
+// heap.
+class CallablePool {
+  public:
+    static constexpr size_t kBlockSize = 64;
+    static constexpr size_t kBlocks = 32;
+
+    static void* allocate(size_t size);
+    static void release(void* block);
+
+    static std::string toString();
+
+  private:
+    struct alignas(std::max_align_t) Block {
+        unsigned char bytes[kBlockSize];
+    };
+    static_assert(kBlocks <= 32, "the free mask has 32 bits");
+
+    static Block sBlocks[kBlocks];
+    static std::atomic<uint32_t> sFree;
+    static std::atomic<uint64_t> sPooled;
+    static std::atomic<uint64_t> sMisses;
+};
+
+// Callable::from() with the callable taken from CallablePool. The virtual destructor of
+// Callable makes the worker return it there once it ran.
+template <typename F>
+class PooledCallable final : public Callable {
+  public:
+    explicit PooledCallable(F func) : mFunc(std::move(func)) {}
+
+    void operator()() override { mFunc(); }
+
+    static void* operator new(size_t size) { return CallablePool::allocate(size); }
+    static void operator delete(void* block) { CallablePool::release(block); }
+
+  private:
+    F mFunc;
+};
+
+template <typename F>
+std::unique_ptr<Callable> pooledCallable(F func) {
+    return std::unique_ptr<Callable>(new PooledCallable<F>(std::move(func)));
+}
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
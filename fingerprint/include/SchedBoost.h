@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <sched.h>
+#include <sys/types.h>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "FingerprintMetrics.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+// Raises uclamp.min and optionally moves every thread of the service, the vendor's matching
+// threads included, to a set of CPUs while an operation is in flight, then puts each thread
+// back the way it was.
+class SchedBoost {
+  public:
+    struct Policy {
+        // 0..1024, 0 leaves uclamp alone.
+        int32_t uclampMin;
+        // CPU list such as "3-7" or "3,5", empty leaves the affinity alone.
+        std::string cpus;
+
+        bool enabled() const { return uclampMin > 0 || !cpus.empty(); }
+    };
+
+    // Applies the policy to the threads that exist right now. Returns false if the policy is
+    // disabled or a boost is already active.
+    bool begin(const Policy& policy);
+    // Reverts an active boost, no-op otherwise.
+    void end();
+    bool active() const;
+
+    std::string toString() const;
+
+  private:
+    struct SavedThread {
+        pid_t tid;
+        bool uclamp;
+        // uclamp.min the thread asked for before the boost, put back by end().
+        uint32_t utilMin;
+        bool affinity;
+        cpu_set_t mask;
+    };
+
+    static bool parseCpus(const std::string& cpus, cpu_set_t* out);
+
+    mutable std::mutex mLock;
+    bool mActive = false;
+    int64_t mStartNs = 0;
+    std::vector<SavedThread> mSaved;
+
+    uint64_t mBoosts = 0;
+    uint64_t mThreads = 0;
+    uint64_t mErrors = 0;
+    LatencyHistogram mDuration;
+};
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
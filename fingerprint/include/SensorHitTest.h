@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/biometrics/fingerprint/SensorLocation.h>
+
+#include <algorithm>
+#include <cstdint>
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+enum class HitTestResult : uint8_t {
+    kAccepted = 0,
+    kOutside,
+    kTooLarge,
+    kCount,
+};
+
+struct HitTestConfig {
+    // Accepted distance beyond the sensor radius, in sensor_location pixels.
+    int32_t marginPx;
+    // Current display resolution relative to the one sensor_location is given in.
+    int32_t scalePercent;
+    // Contacts with a larger major or minor axis are palms, in sensor_location pixels.
+    // 0 disables palm rejection.
+    int32_t maxContactPx;
+};
+
+// Whether a touch at (x, y) in current display pixels is a finger on the sensor. Integer math
+// only, no allocation. An unconfigured sensor location accepts everything.
+inline HitTestResult hitTest(const SensorLocation& location, const HitTestConfig& config,
+                             int32_t x, int32_t y, float minor, float major) {
+    if (location.sensorRadius <= 0) {
+        return HitTestResult::kAccepted;
+    }
+    int64_t scale = config.scalePercent > 0 ? config.scalePercent : 100;
+
+    if (config.maxContactPx > 0 &&
+        std::max(minor, major) * 100 > static_cast<float>(config.maxContactPx * scale)) {
+        return HitTestResult::kTooLarge;
+    }
+
+    int64_t dx = x * 100LL - location.sensorLocationX * scale;
+    int64_t dy = y * 100LL - location.sensorLocationY * scale;
+    int64_t reach = (location.sensorRadius + std::max(config.marginPx, 0)) * scale;
+    return dx * dx + dy * dy <= reach * reach ? HitTestResult::kAccepted : HitTestResult::kOutside;
+}
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
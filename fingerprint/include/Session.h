@@ -19,11 +19,18 @@
 #include <aidl/android/hardware/biometrics/fingerprint/BnSession.h>
 #include <aidl/android/hardware/biometrics/fingerprint/ISessionCallback.h>
 
-#include "FingerprintEngine.h"
-#include "thread/WorkerThread.h"
+#include "CallbackAggregator.h"
+#include "CallbackDispatcher.h"
+#include "FingerprintEngineSelect.h"
+#include "WorkScheduler.h"
 
 #include "Legacy2Aidl.h"
 
+#include <atomic>
+#include <functional>
+#include <future>
+#include <mutex>
+
 namespace aidl::android::hardware::biometrics::fingerprint {
 
 namespace common = aidl::android::hardware::biometrics::common;
@@ -34,7 +41,7 @@ void onClientDeath(void* cookie);
 class Session : public BnSession {
   public:
     Session(int sensorId, int userId, std::shared_ptr<ISessionCallback> cb,
-            FingerprintEngine* engine, WorkerThread* worker);
+            Engine* engine, WorkScheduler* worker);
 
     ndk::ScopedAStatus generateChallenge() override;
 
@@ -90,31 +97,61 @@ class Session : public BnSession {
 
     ndk::ScopedAStatus setIgnoreDisplayTouches(bool shouldIgnore) override;
 
+    // Makes a closed session usable again for a new client of the same sensor and user.
+    void reopen(std::shared_ptr<ISessionCallback> cb);
+
     binder_status_t linkToDeath(AIBinder* binder);
 
     bool isClosed();
 
+    int32_t getSensorId() const { return mSensorId; }
+    int32_t getUserId() const { return mUserId; }
+
     void notify(const fingerprint_msg_t* msg);
+
+    std::string toString() const;
+
   private:
+    std::shared_ptr<ISessionCallback> callback() const;
+
+    // Queues an enroll/authenticate/detectInteraction and returns its cancellation signal.
+    // The name labels its async track in traces.
+    std::shared_ptr<common::ICancellationSignal> scheduleOperation(
+            const char* name, std::function<void(const std::future<void>&)> start);
+
     // The sensor and user IDs for which this session was created.
     int32_t mSensorId;
     int32_t mUserId;
 
-    // Callback for talking to the framework. This callback must only be called from non-binder
-    // threads to prevent nested binder calls and consequently a binder thread exhaustion.
-    // Practically, it means that this callback should always be called from the worker thread.
+    // Delivers the callbacks below in order on a thread of its own.
+    CallbackDispatcher mCallbacks;
+
+    // Callback for talking to the framework, wrapped by mCallbacks: calls only queue the
+    // transaction and return, so they are safe from any thread, including binder threads.
+    // reopen() swaps it on a binder thread while the worker and the notify thread use it, so it
+    // is only read through callback().
+    mutable std::mutex mCbLock;
     std::shared_ptr<ISessionCallback> mCb;
 
     // Module that communicates to the actual fingerprint hardware, keystore, TEE, etc. In real
     // life such modules typically consume a lot of memory and are slow to initialize. This is here
     // to showcase how such a module can be used within a Session without incurring the high
     // initialization costs every time a Session is constructed.
-    FingerprintEngine* mEngine;
-
-    // Worker thread that allows to schedule tasks for asynchronous execution.
-    WorkerThread* mWorker;
-
-    bool mIsClosed;
+    Engine* mEngine;
+
+    // Worker thread that allows to schedule tasks for asynchronous execution. Pointer events go
+    // to its high-priority lane so they never wait behind a slow vendor operation.
+    WorkScheduler* mWorker;
+
+    std::atomic<bool> mIsClosed;
+    // Pointer whose down failed the hit test, its up is dropped as well.
+    static constexpr int32_t kNoPointer = -1;
+    std::atomic<int32_t> mRejectedPointerId;
+    // Batches vendor messages into framework callbacks, used from the notify thread.
+    CallbackAggregator mAggregator;
+    // Reused by notify() for the callback arguments, so delivering a result does not allocate.
+    keymaster::HardwareAuthToken mAuthToken;
+    std::vector<int32_t> mEnrollments;
     // Binder death handler.
     AIBinder_DeathRecipient* mDeathRecipient;
 };
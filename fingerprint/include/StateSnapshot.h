@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <type_traits>
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+// Everything that survives a restart of the lazy service. Stored as is, so bump kVersion
+// whenever the layout changes.
+struct PersistentState {
+    static constexpr uint32_t kVersion = 1;
+    static constexpr size_t kMaxUsers = 4;
+    static constexpr size_t kBootIdSize = 40;
+
+    // Boot the boot-scoped fields belong to, from /proc/sys/kernel/random/boot_id.
+    char bootId[kBootIdSize];
+
+    // Boot-scoped: CLOCK_MONOTONIC timestamps and vendor state that does not outlive a boot.
+    struct {
+        int32_t failedCount;
+        int8_t mode;
+        int64_t timedStartNs;
+    } lockout;
+    struct {
+        int32_t userId;  // -1 if unused
+        int64_t id;
+    } authenticatorIds[kMaxUsers];
+
+    // Carried over from boot to boot.
+    uint64_t starts;
+    uint64_t warmStarts;
+    uint64_t unlocks[2];  // indexed by success
+    int64_t lastColdStartNs;
+    int64_t lastWarmStartNs;
+
+    void clearBootScoped();
+};
+
+static_assert(std::is_trivially_copyable_v<PersistentState>);
+
+// Keeps PersistentState in a small memory-mapped file with two checksummed slots. An update is
+// written to the older slot and only becomes current once its checksum is complete, so a crash
+// or power loss in the middle of a write falls back to the previous state.
+class StateSnapshot {
+  public:
+    explicit StateSnapshot(const char* path);
+    ~StateSnapshot();
+
+    StateSnapshot(const StateSnapshot&) = delete;
+    StateSnapshot& operator=(const StateSnapshot&) = delete;
+
+    // Maps the file and restores the newest valid slot. Boot-scoped fields written during
+    // another boot are dropped. Returns true if state of the current boot was restored.
+    bool load();
+
+    PersistentState state() const;
+
+    // Applies the change in memory and commits it to the file.
+    void update(const std::function<void(PersistentState*)>& change);
+
+    std::string toString() const;
+
+  private:
+    struct Slot;
+
+    void commitLocked();
+
+    const char* mPath;
+    mutable std::mutex mLock;
+    PersistentState mState;
+    Slot* mSlots;
+    size_t mActive;
+    uint64_t mSeq;
+
+    bool mRestored;
+    uint64_t mCorruptSlots;
+    uint64_t mCommits;
+    int64_t mLoadTimeNs;
+};
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <android-base/unique_fd.h>
+
+#include <array>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "FingerprintMetrics.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+// Write-only control node that stays open for the lifetime of the service. Writes go through
+// pwrite() from the caller's buffer, a value equal to the last one written successfully is
+// skipped, and a failed write reopens the node and retries once. Whoever knows the node changed
+// behind our back, the driver updating fod_press_status or a recovery resetting the panel,
+// calls invalidate() so the next write reaches the driver.
+class SysfsNode {
+  public:
+    explicit SysfsNode(const char* path);
+
+    SysfsNode(const SysfsNode&) = delete;
+    SysfsNode& operator=(const SysfsNode&) = delete;
+
+    bool write(std::string_view value);
+    bool write(int value);
+
+    // Forget the last written value, the next write goes to the driver whatever it is.
+    void invalidate();
+
+    std::string toString() const;
+
+  private:
+    static constexpr size_t kMaxValueSize = 16;
+
+    bool writeLocked(std::string_view value);
+
+    const char* mPath;
+    mutable std::mutex mLock;
+    ::android::base::unique_fd mFd;
+    std::array<char, kMaxValueSize> mLast{};
+    size_t mLastSize;
+    bool mLastValid;
+
+    uint64_t mWrites;
+    uint64_t mSkipped;
+    uint64_t mErrors;
+    uint64_t mReopens;
+    LatencyHistogram mLatency;
+};
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
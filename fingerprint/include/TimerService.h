@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <android-base/unique_fd.h>
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+// One thread and one timerfd serving every timeout of the HAL. Actions run on the timer thread
+// and are expected to be short, typically posting work to the WorkScheduler. Cancelling drops
+// the action from a hash map; its heap entry is discarded lazily when it reaches the top.
+class TimerService {
+  public:
+    using TimerId = uint64_t;
+    static constexpr TimerId kInvalidTimer = 0;
+
+    TimerService();
+    ~TimerService();
+
+    TimerService(const TimerService&) = delete;
+    TimerService& operator=(const TimerService&) = delete;
+
+    TimerId schedule(int64_t delayMs, std::function<void()> action);
+
+    // Returns false if the timer already fired or was never scheduled.
+    bool cancel(TimerId id);
+
+    std::string toString() const;
+
+  private:
+    using Deadline = std::pair<int64_t, TimerId>;
+
+    void rearmLocked();
+    void threadFunc();
+
+    mutable std::mutex mLock;
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> mDeadlines;
+    std::unordered_map<TimerId, std::function<void()>> mActions;
+    TimerId mNextId;
+    int64_t mArmedDeadline;
+
+    uint64_t mFired;
+    uint64_t mCancelled;
+
+    ::android::base::unique_fd mTimerFd;
+    ::android::base::unique_fd mStopFd;
+    std::thread mThread;
+};
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
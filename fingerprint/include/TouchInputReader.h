@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <android-base/unique_fd.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+
+struct input_event;
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+// Follows the multi-touch (protocol B) stream of a touch evdev node on its own epoll thread and
+// reports contacts as they land and lift, without waiting for the framework's input pipeline.
+// Coordinates are the touch panel's, timestamps are CLOCK_MONOTONIC nanoseconds of the kernel
+// event. Works against any evdev node, including a uinput device.
+class TouchInputReader {
+  public:
+    // Both handlers run on the reader thread.
+    using DownHandler = std::function<void(int32_t slot, int32_t x, int32_t y, int64_t timeNs)>;
+    using UpHandler = std::function<void(int32_t slot, int64_t timeNs)>;
+
+    TouchInputReader(DownHandler onDown, UpHandler onUp);
+    ~TouchInputReader();
+
+    TouchInputReader(const TouchInputReader&) = delete;
+    TouchInputReader& operator=(const TouchInputReader&) = delete;
+
+    bool start(const std::string& path);
+
+    std::string toString() const;
+
+  private:
+    static constexpr int32_t kMaxSlots = 10;
+
+    struct Contact {
+        int32_t trackingId = -1;
+        int32_t x = -1;
+        int32_t y = -1;
+        bool reported = false;
+    };
+
+    void threadFunc();
+    void handleEvent(const input_event& event);
+    void sync(int64_t timeNs);
+    void resync();
+    void releaseAll(int64_t timeNs);
+
+    DownHandler mOnDown;
+    UpHandler mOnUp;
+    std::string mPath;
+
+    // Only touched by the reader thread.
+    std::array<Contact, kMaxSlots> mContacts;
+    int32_t mSlot;
+    bool mDropping;
+
+    std::atomic<uint64_t> mEvents{0};
+    std::atomic<uint64_t> mDowns{0};
+    std::atomic<uint64_t> mUps{0};
+    std::atomic<uint64_t> mSynDropped{0};
+
+    ::android::base::unique_fd mInputFd;
+    ::android::base::unique_fd mEpollFd;
+    ::android::base::unique_fd mStopFd;
+    std::thread mThread;
+};
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
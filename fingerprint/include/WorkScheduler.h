@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "FingerprintMetrics.h"
+#include "thread/Callable.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+// Single worker thread with two lanes. Touch-critical work (pointer events, UI ready,
+// illumination) and cancellation go to the high-priority lane and always run before queued
+// operations.
+//
+// Overflow policy:
+//  - terminal operations (anything that owes the framework a terminal callback) are never
+//    dropped; they are admitted past the limit and counted,
+//  - a pointer up cancels a pointer down for the same pointer that has not run yet, both are
+//    coalesced away,
+//  - when the high-priority lane is full the oldest evictable entry is evicted. Only pointer
+//    down, UI ready and wakeups are evictable, everything else turns local HBM off or idles the
+//    device and always runs.
+class WorkScheduler {
+  public:
+    enum class TaskKind : uint8_t {
+        kTerminal = 0,
+        kPointerDown,
+        kPointerUp,
+        kUiReady,
+        // Turning local HBM off when the pointer up never arrived.
+        kIllumination,
+        kCancel,
+        // Reopening a hung vendor device.
+        kRecovery,
+        // Arming the sensor on a wakeup, ahead of the framework.
+        kWake,
+        // A vendor message moving the FOD state machine.
+        kFodEvent,
+    };
+
+    explicit WorkScheduler(size_t maxQueueSize);
+    ~WorkScheduler();
+
+    WorkScheduler(const WorkScheduler&) = delete;
+    WorkScheduler& operator=(const WorkScheduler&) = delete;
+
+    // Schedules a terminal operation on the normal lane.
+    bool schedule(std::unique_ptr<Callable> task);
+
+    bool schedule(TaskKind kind, std::unique_ptr<Callable> task, int32_t pointerId = 0);
+
+    // Gives up on the worker thread if it is the stuck thread, and starts a new one that runs
+    // recovery first and then picks up the queues. The stuck thread exits once its task
+    // returns. Returns false, doing nothing, if the stuck thread is not the worker. Not to be
+    // called from the worker itself.
+    bool abandonThread(std::thread::id stuck, std::unique_ptr<Callable> recovery);
+
+    // Whether the calling thread is the current worker thread.
+    bool isWorkerThread() const;
+    // Whether the calling thread is a worker thread that was abandoned. Its task is still
+    // unwinding and must not touch anything the new worker owns.
+    bool isAbandonedThread() const;
+
+    std::string toString() const;
+
+  private:
+    enum Lane : uint8_t { kNormal = 0, kHigh, kLaneCount };
+
+    struct Task {
+        TaskKind kind;
+        int32_t pointerId;
+        int64_t enqueueTime;
+        std::unique_ptr<Callable> callable;
+    };
+
+    static Lane laneFor(TaskKind kind) { return kind == TaskKind::kTerminal ? kNormal : kHigh; }
+    static bool isEvictable(TaskKind kind) {
+        return kind == TaskKind::kPointerDown || kind == TaskKind::kUiReady ||
+               kind == TaskKind::kWake;
+    }
+
+    bool coalesceLocked(const Task& task);
+    void evictLocked(Lane lane);
+    void traceDepthLocked(Lane lane);
+    void threadFunc(uint64_t generation);
+
+    const size_t mMaxSize;
+    bool mIsDestructing;
+    // Bumped under mQueueMutex whenever the worker thread is replaced, read without it by the
+    // worker threads to tell whether they are still current.
+    std::atomic<uint64_t> mGeneration;
+    std::array<std::deque<Task>, kLaneCount> mQueues;
+    mutable std::mutex mQueueMutex;
+    std::condition_variable mQueueCond;
+
+    // Statistics, guarded by mQueueMutex.
+    std::array<size_t, kLaneCount> mMaxDepth{};
+    uint64_t mCoalesced = 0;
+    uint64_t mDropped = 0;
+    uint64_t mOverflowAdmitted = 0;
+    uint64_t mAbandoned = 0;
+    std::array<LatencyHistogram, kLaneCount> mWaitTime;
+
+    std::thread mThread;
+};
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
@@ -97,6 +97,11 @@ typedef enum fingerprint_acquired_info {
     FINGERPRINT_ACQUIRED_VENDOR_BASE = 1000 /* vendor-specific acquisition messages start here */
 } fingerprint_acquired_info_t;
 
+/* Vendor acquisition codes, sent as FINGERPRINT_ACQUIRED_VENDOR_BASE + code. */
+#define FINGERPRINT_ACQUIRED_VENDOR_WAITING_AUTHENTICATE 21 /* waiting for a finger to match */
+#define FINGERPRINT_ACQUIRED_VENDOR_WAITING_ENROLL 23       /* waiting for a finger to enroll */
+#define FINGERPRINT_ACQUIRED_VENDOR_SCAN_FAILED 44          /* the capture failed */
+
 typedef struct fingerprint_finger_id {
     uint32_t fid;
 } fingerprint_finger_id_t;
@@ -20,11 +20,18 @@
 #include <android/binder_manager.h>
 #include <android/binder_process.h>
 
+#include <algorithm>
+
 using aidl::android::hardware::biometrics::fingerprint::Fingerprint;
 
 int main()
 {
-    ABinderProcess_setThreadPoolMaxThreadCount(0);
+    // Callbacks go out on per-session threads, so incoming calls are all that the pool serves.
+    int32_t binderThreads = std::max(Fingerprint::cfg().snapshot().binderThreads, 0);
+    ABinderProcess_setThreadPoolMaxThreadCount(binderThreads);
+    if (binderThreads > 0) {
+        ABinderProcess_startThreadPool();
+    }
 
     std::shared_ptr<Fingerprint> hal = ndk::SharedRefBase::make<Fingerprint>();
     const std::string instance = std::string(Fingerprint::descriptor) + "/default";
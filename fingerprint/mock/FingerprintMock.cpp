@@ -0,0 +1,361 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Stand-in for the vendor fingerprint module. It implements the fingerprint_device_t ABI of
+// fingerprint-xiaomi.h and answers with scripted message sequences, so the HAL can be exercised
+// and profiled on a device without a working sensor. Select it with
+//   setprop persist.vendor.fingerprint.cached_module mock
+// and tune it with the vendor.fps_hal.mock.* properties read when the device is opened.
+
+#define LOG_TAG "FingerprintMock"
+
+#include <android-base/logging.h>
+#include <android-base/properties.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "fingerprint-xiaomi.h"
+
+namespace {
+
+using ::android::base::GetIntProperty;
+using Clock = std::chrono::steady_clock;
+
+// Time between a finger press and the match result, and between two enroll samples.
+constexpr int kDefaultMatchLatencyMs = 150;
+// Share of presses that are rejected, in percent.
+constexpr int kDefaultFailurePercent = 0;
+constexpr int kDefaultEnrollSteps = 6;
+
+enum class MockOperation {
+    kIdle,
+    kEnrolling,
+    kAuthenticating,
+};
+
+struct MockDevice {
+    // Must be the first member, the HAL casts between the two.
+    fingerprint_device_t device;
+
+    int matchLatencyMs;
+    int failurePercent;
+    int enrollSteps;
+
+    std::mutex lock;
+    std::condition_variable cond;
+    std::deque<std::pair<Clock::time_point, fingerprint_msg_t>> events;
+    bool stopping = false;
+    std::thread thread;
+
+    MockOperation operation = MockOperation::kIdle;
+    uint64_t operationId = 0;
+    uint32_t enrollRemaining = 0;
+    uint32_t group = 0;
+    uint32_t nextFid = 1;
+    uint64_t authenticatorId = 1;
+    std::map<uint32_t, std::vector<uint32_t>> templates;
+    std::mt19937 rng{std::random_device{}()};
+};
+
+MockDevice* toMock(fingerprint_device_t* dev) {
+    return reinterpret_cast<MockDevice*>(dev);
+}
+
+// Messages are delivered from the mock's own thread, like the vendor module does.
+void postLocked(MockDevice* mock, const fingerprint_msg_t& msg, int delayMs = 0) {
+    auto due = Clock::now() + std::chrono::milliseconds(delayMs);
+    if (!mock->events.empty()) due = std::max(due, mock->events.back().first);
+    mock->events.emplace_back(due, msg);
+    mock->cond.notify_one();
+}
+
+void postError(MockDevice* mock, fingerprint_error_t error) {
+    fingerprint_msg_t msg = {};
+    msg.type = FINGERPRINT_ERROR;
+    msg.data.error = error;
+    postLocked(mock, msg);
+}
+
+void postExtend(MockDevice* mock, fingerprint_msg_type_t type, int64_t data) {
+    fingerprint_msg_t msg = {};
+    msg.type = type;
+    msg.data.extend.data = data;
+    postLocked(mock, msg);
+}
+
+bool rollFailure(MockDevice* mock) {
+    return std::uniform_int_distribution<int>(0, 99)(mock->rng) < mock->failurePercent;
+}
+
+void threadFunc(MockDevice* mock) {
+    std::unique_lock<std::mutex> lock(mock->lock);
+    while (true) {
+        if (mock->stopping) return;
+        if (mock->events.empty()) {
+            mock->cond.wait(lock);
+            continue;
+        }
+        auto due = mock->events.front().first;
+        if (Clock::now() < due) {
+            mock->cond.wait_until(lock, due);
+            continue;
+        }
+        fingerprint_msg_t msg = mock->events.front().second;
+        mock->events.pop_front();
+        fingerprint_notify_t notify = mock->device.notify;
+        lock.unlock();
+        if (notify) notify(&msg);
+        lock.lock();
+    }
+}
+
+// A finger landed on the sensor: produce the next step of the current operation.
+void onFingerPressedLocked(MockDevice* mock) {
+    fingerprint_msg_t acquired = {};
+    acquired.type = FINGERPRINT_ACQUIRED;
+    acquired.data.acquired.acquired_info = FINGERPRINT_ACQUIRED_GOOD;
+
+    switch (mock->operation) {
+        case MockOperation::kEnrolling: {
+            if (rollFailure(mock)) {
+                acquired.data.acquired.acquired_info = FINGERPRINT_ACQUIRED_PARTIAL;
+                postLocked(mock, acquired, mock->matchLatencyMs);
+                return;
+            }
+            postLocked(mock, acquired, mock->matchLatencyMs);
+            fingerprint_msg_t msg = {};
+            msg.type = FINGERPRINT_TEMPLATE_ENROLLING;
+            msg.data.enroll.fid = mock->nextFid;
+            msg.data.enroll.samples_remaining = --mock->enrollRemaining;
+            postLocked(mock, msg);
+            if (mock->enrollRemaining == 0) {
+                mock->templates[mock->group].push_back(mock->nextFid++);
+                mock->operation = MockOperation::kIdle;
+            }
+        } break;
+        case MockOperation::kAuthenticating: {
+            postLocked(mock, acquired, mock->matchLatencyMs);
+            const auto& enrolled = mock->templates[mock->group];
+            fingerprint_msg_t msg = {};
+            msg.type = FINGERPRINT_AUTHENTICATED;
+            if (!enrolled.empty() && !rollFailure(mock)) {
+                msg.data.authenticated.finger.fid = enrolled.front();
+                msg.data.authenticated.hat.challenge = mock->operationId;
+                msg.data.authenticated.hat.user_id = mock->group;
+                msg.data.authenticated.hat.authenticator_id = mock->authenticatorId;
+                mock->operation = MockOperation::kIdle;
+            }
+            postLocked(mock, msg);
+        } break;
+        case MockOperation::kIdle:
+            break;
+    }
+}
+
+int mockSetNotify(fingerprint_device_t* dev, fingerprint_notify_t notify) {
+    std::lock_guard<std::mutex> lock(toMock(dev)->lock);
+    dev->notify = notify;
+    return 0;
+}
+
+uint64_t mockGenerateChallenge(fingerprint_device_t* dev) {
+    auto* mock = toMock(dev);
+    std::lock_guard<std::mutex> lock(mock->lock);
+    uint64_t challenge = std::uniform_int_distribution<uint64_t>()(mock->rng);
+    postExtend(mock, FINGERPRINT_CHALLENGE_GENERATED, challenge);
+    return challenge;
+}
+
+uint32_t mockRevokeChallenge(fingerprint_device_t* dev, uint64_t challenge) {
+    auto* mock = toMock(dev);
+    std::lock_guard<std::mutex> lock(mock->lock);
+    postExtend(mock, FINGERPRINT_CHALLENGE_REVOKED, challenge);
+    return 0;
+}
+
+uint32_t mockEnroll(fingerprint_device_t* dev, const hw_auth_token_t* /*hat*/) {
+    auto* mock = toMock(dev);
+    std::lock_guard<std::mutex> lock(mock->lock);
+    mock->operation = MockOperation::kEnrolling;
+    mock->enrollRemaining = mock->enrollSteps;
+    return 0;
+}
+
+uint64_t mockGetAuthenticatorId(fingerprint_device_t* dev) {
+    auto* mock = toMock(dev);
+    std::lock_guard<std::mutex> lock(mock->lock);
+    postExtend(mock, FINGERPRINT_AUTHENTICATOR_ID_RETRIEVED, mock->authenticatorId);
+    return mock->authenticatorId;
+}
+
+uint64_t mockInvalidateAuthenticatorId(fingerprint_device_t* dev) {
+    auto* mock = toMock(dev);
+    std::lock_guard<std::mutex> lock(mock->lock);
+    postExtend(mock, FINGERPRINT_AUTHENTICATOR_ID_INVALIDATED, ++mock->authenticatorId);
+    return mock->authenticatorId;
+}
+
+uint32_t mockCancel(fingerprint_device_t* dev) {
+    auto* mock = toMock(dev);
+    std::lock_guard<std::mutex> lock(mock->lock);
+    // Steps of the cancelled operation that are still pending never get delivered.
+    mock->events.erase(std::remove_if(mock->events.begin(), mock->events.end(),
+                                      [](const auto& event) {
+                                          return event.second.type == FINGERPRINT_ACQUIRED ||
+                                                 event.second.type == FINGERPRINT_AUTHENTICATED ||
+                                                 event.second.type ==
+                                                         FINGERPRINT_TEMPLATE_ENROLLING;
+                                      }),
+                       mock->events.end());
+    mock->operation = MockOperation::kIdle;
+    postError(mock, FINGERPRINT_ERROR_CANCELED);
+    return 0;
+}
+
+uint32_t mockEnumerate(fingerprint_device_t* dev) {
+    auto* mock = toMock(dev);
+    std::lock_guard<std::mutex> lock(mock->lock);
+    const auto& enrolled = mock->templates[mock->group];
+    fingerprint_msg_t msg = {};
+    msg.type = FINGERPRINT_TEMPLATE_ENUMERATING;
+    if (enrolled.empty()) {
+        postLocked(mock, msg);
+        return 0;
+    }
+    for (size_t i = 0; i < enrolled.size(); i++) {
+        msg.data.enumerated.fid = enrolled[i];
+        msg.data.enumerated.remaining_templates = enrolled.size() - i - 1;
+        postLocked(mock, msg);
+    }
+    return 0;
+}
+
+uint64_t mockRemove(fingerprint_device_t* dev, const int32_t* enrollmentIds, uint32_t count) {
+    auto* mock = toMock(dev);
+    std::lock_guard<std::mutex> lock(mock->lock);
+    auto& enrolled = mock->templates[mock->group];
+    fingerprint_msg_t msg = {};
+    msg.type = FINGERPRINT_TEMPLATE_REMOVED;
+    for (uint32_t i = 0; i < count; i++) {
+        std::erase(enrolled, static_cast<uint32_t>(enrollmentIds[i]));
+        msg.data.removed.fid = enrollmentIds[i];
+        msg.data.removed.remaining_templates = count - i - 1;
+        postLocked(mock, msg);
+    }
+    return 0;
+}
+
+uint32_t mockSetActiveGroup(fingerprint_device_t* dev, uint32_t userid,
+                            const char* /*store_path*/) {
+    auto* mock = toMock(dev);
+    std::lock_guard<std::mutex> lock(mock->lock);
+    mock->group = userid;
+    return 0;
+}
+
+uint32_t mockAuthenticate(fingerprint_device_t* dev, uint64_t operation_id) {
+    auto* mock = toMock(dev);
+    std::lock_guard<std::mutex> lock(mock->lock);
+    mock->operation = MockOperation::kAuthenticating;
+    mock->operationId = operation_id;
+    return 0;
+}
+
+uint32_t mockResetLockout(fingerprint_device_t* /*dev*/, const hw_auth_token_t* /*hat*/) {
+    return 0;
+}
+
+void mockOnPointerDown(fingerprint_device_t* /*dev*/, int32_t /*pointerId*/, int32_t /*x*/,
+                       int32_t /*y*/, float /*minor*/, float /*major*/) {}
+
+void mockOnPointerUp(fingerprint_device_t* /*dev*/, int32_t /*pointerId*/) {}
+
+uint64_t mockGoodixExtCmd(fingerprint_device_t* dev, int32_t cmd, int32_t param) {
+    auto* mock = toMock(dev);
+    std::lock_guard<std::mutex> lock(mock->lock);
+    if (cmd == COMMAND_FOD_PRESS_STATUS && param == PARAM_FOD_PRESSED) {
+        onFingerPressedLocked(mock);
+    }
+    return 0;
+}
+
+int mockClose(hw_device_t* device) {
+    auto* mock = reinterpret_cast<MockDevice*>(device);
+    {
+        std::lock_guard<std::mutex> lock(mock->lock);
+        mock->stopping = true;
+        mock->cond.notify_one();
+    }
+    mock->thread.join();
+    delete mock;
+    return 0;
+}
+
+int mockOpen(const hw_module_t* module, const char* /*id*/, hw_device_t** device) {
+    auto* mock = new MockDevice();
+    mock->matchLatencyMs =
+            GetIntProperty("vendor.fps_hal.mock.latency_ms", kDefaultMatchLatencyMs, 0, 10000);
+    mock->failurePercent =
+            GetIntProperty("vendor.fps_hal.mock.failure_percent", kDefaultFailurePercent, 0, 100);
+    mock->enrollSteps =
+            GetIntProperty("vendor.fps_hal.mock.enroll_steps", kDefaultEnrollSteps, 1, 100);
+
+    fingerprint_device_t* dev = &mock->device;
+    dev->common.tag = HARDWARE_DEVICE_TAG;
+    dev->common.version = FINGERPRINT_MODULE_API_VERSION_2_1;
+    dev->common.module = const_cast<hw_module_t*>(module);
+    dev->common.close = mockClose;
+    dev->set_notify = mockSetNotify;
+    dev->generateChallenge = mockGenerateChallenge;
+    dev->revokeChallenge = mockRevokeChallenge;
+    dev->enroll = mockEnroll;
+    dev->getAuthenticatorId = mockGetAuthenticatorId;
+    dev->invalidateAuthenticatorId = mockInvalidateAuthenticatorId;
+    dev->cancel = mockCancel;
+    dev->enumerate = mockEnumerate;
+    dev->remove = mockRemove;
+    dev->setActiveGroup = mockSetActiveGroup;
+    dev->authenticate = mockAuthenticate;
+    dev->resetLockout = mockResetLockout;
+    dev->onPointerDown = mockOnPointerDown;
+    dev->onPointerUp = mockOnPointerUp;
+    dev->goodixExtCmd = mockGoodixExtCmd;
+
+    mock->thread = std::thread(threadFunc, mock);
+
+    LOG(INFO) << "Opened mock fingerprint device, latency=" << mock->matchLatencyMs
+              << "ms failure=" << mock->failurePercent << "% enrollSteps=" << mock->enrollSteps;
+    *device = &dev->common;
+    return 0;
+}
+
+hw_module_methods_t gMockMethods = {
+        .open = mockOpen,
+};
+
+}  // namespace
+
+fingerprint_module_t HAL_MODULE_INFO_SYM __attribute__((visibility("default"))) = {
+        .common =
+                {
+                        .tag = HARDWARE_MODULE_TAG,
+                        .module_api_version = FINGERPRINT_MODULE_API_VERSION_2_1,
+                        .hal_api_version = HARDWARE_HAL_API_VERSION,
+                        .id = FINGERPRINT_HARDWARE_MODULE_ID,
+                        .name = "Mock fingerprint HAL",
+                        .author = "The LineageOS Project",
+                        .methods = &gMockMethods,
+                },
+};
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Counts heap allocations while authenticate runs against the mock module. Once warmed up,
+// nothing on the way from a vendor message to the AIDL callback may allocate: neither the
+// notify dispatcher thread, which translates the message and runs the engine's reaction, nor
+// the callback thread, which calls into the framework.
+
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "MockHarness.h"
+
+namespace {
+
+std::atomic<uint64_t> gAllocations{0};
+std::atomic<uint64_t> gDeliveryAllocations{0};
+
+// Whether the calling thread delivers vendor messages, by the names the dispatchers give their
+// threads. Checked once per thread, prctl() does not allocate.
+bool isDeliveryThread() {
+    thread_local int delivery = -1;
+    if (delivery < 0) {
+        char name[16] = {};
+        pthread_getname_np(pthread_self(), name, sizeof(name));
+        delivery = strcmp(name, "FpNotify") == 0 || strcmp(name, "FpCallback") == 0;
+    }
+    return delivery;
+}
+
+void* countedAlloc(size_t size) {
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (isDeliveryThread()) gDeliveryAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* block = malloc(size == 0 ? 1 : size)) return block;
+    abort();
+}
+
+}  // namespace
+
+void* operator new(size_t size) {
+    return countedAlloc(size);
+}
+void* operator new[](size_t size) {
+    return countedAlloc(size);
+}
+void operator delete(void* block) noexcept {
+    free(block);
+}
+void operator delete[](void* block) noexcept {
+    free(block);
+}
+void operator delete(void* block, size_t) noexcept {
+    free(block);
+}
+void operator delete[](void* block, size_t) noexcept {
+    free(block);
+}
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+namespace {
+
+// Enough to grow every ring and reuse every buffer on the path to its final size.
+constexpr int kWarmupRounds = 10;
+constexpr int kCountedRounds = 50;
+
+class AllocationTest : public MockHarness {
+  protected:
+    void authenticate(int round) {
+        std::shared_ptr<common::ICancellationSignal> cancel;
+        ASSERT_TRUE(mSession->authenticate(0, &cancel).isOk());
+        ASSERT_TRUE(pressUntil(Method::kAuthenticationSucceeded, round)) << "round " << round;
+    }
+};
+
+TEST_F(AllocationTest, AuthenticateDeliveryDoesNotAllocate) {
+    ASSERT_GT(enroll(), 0);
+    for (int round = 1; round <= kWarmupRounds; round++) {
+        authenticate(round);
+    }
+
+    uint64_t allocations = gAllocations.load();
+    uint64_t deliveryAllocations = gDeliveryAllocations.load();
+    for (int round = kWarmupRounds + 1; round <= kWarmupRounds + kCountedRounds; round++) {
+        authenticate(round);
+    }
+    allocations = gAllocations.load() - allocations;
+    deliveryAllocations = gDeliveryAllocations.load() - deliveryAllocations;
+    EXPECT_EQ(mCb->count(Method::kError), 0u);
+
+    // The rest is the binder call itself: authenticate() hands out a new ICancellationSignal
+    // and queues the operation, and the test presses the finger.
+    double perRound = static_cast<double>(allocations) / kCountedRounds;
+    RecordProperty("allocations_per_authenticate", static_cast<int>(perRound));
+    printf("allocations per authenticate: %.2f, of them delivering vendor messages: %.2f\n",
+           perRound, static_cast<double>(deliveryAllocations) / kCountedRounds);
+    EXPECT_EQ(deliveryAllocations, 0u);
+}
+
+}  // namespace
+}  // namespace aidl::android::hardware::biometrics::fingerprint
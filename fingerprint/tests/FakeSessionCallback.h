@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/biometrics/fingerprint/BnSessionCallback.h>
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "CallbackDispatcher.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+// Counts the callbacks it gets and keeps the last argument of each, for tests to wait on.
+// Recording does not allocate, so it can stand in for the framework in allocation counts too.
+class FakeSessionCallback : public BnSessionCallback {
+  public:
+    using Method = CallbackDispatcher::Method;
+
+    uint64_t count(Method method) const {
+        std::lock_guard<std::mutex> lock(mLock);
+        return mCounts[index(method)];
+    }
+
+    // The last scalar argument of method: the enrollment ID of a success, the error of onError,
+    // the remaining samples of an enrollment step, the size of an enrollment list, ...
+    int64_t last(Method method) const {
+        std::lock_guard<std::mutex> lock(mLock);
+        return mLast[index(method)];
+    }
+
+    // Waits until method was called count times in total.
+    bool waitFor(Method method, uint64_t count,
+                 std::chrono::milliseconds timeout = std::chrono::seconds(5)) {
+        std::unique_lock<std::mutex> lock(mLock);
+        return mCond.wait_for(lock, timeout,
+                              [&] { return mCounts[index(method)] >= count; });
+    }
+
+    ndk::ScopedAStatus onChallengeGenerated(int64_t challenge) override {
+        return record(Method::kChallengeGenerated, challenge);
+    }
+    ndk::ScopedAStatus onChallengeRevoked(int64_t challenge) override {
+        return record(Method::kChallengeRevoked, challenge);
+    }
+    ndk::ScopedAStatus onAcquired(AcquiredInfo info, int32_t /*vendorCode*/) override {
+        return record(Method::kAcquired, static_cast<int64_t>(info));
+    }
+    ndk::ScopedAStatus onError(Error error, int32_t /*vendorCode*/) override {
+        return record(Method::kError, static_cast<int64_t>(error));
+    }
+    ndk::ScopedAStatus onEnrollmentProgress(int32_t /*enrollmentId*/, int32_t remaining) override {
+        return record(Method::kEnrollmentProgress, remaining);
+    }
+    ndk::ScopedAStatus onAuthenticationSucceeded(
+            int32_t enrollmentId, const keymaster::HardwareAuthToken& /*hat*/) override {
+        return record(Method::kAuthenticationSucceeded, enrollmentId);
+    }
+    ndk::ScopedAStatus onAuthenticationFailed() override {
+        return record(Method::kAuthenticationFailed, 0);
+    }
+    ndk::ScopedAStatus onLockoutTimed(int64_t durationMillis) override {
+        return record(Method::kLockoutTimed, durationMillis);
+    }
+    ndk::ScopedAStatus onLockoutPermanent() override {
+        return record(Method::kLockoutPermanent, 0);
+    }
+    ndk::ScopedAStatus onLockoutCleared() override { return record(Method::kLockoutCleared, 0); }
+    ndk::ScopedAStatus onInteractionDetected() override {
+        return record(Method::kInteractionDetected, 0);
+    }
+    ndk::ScopedAStatus onEnrollmentsEnumerated(const std::vector<int32_t>& ids) override {
+        return record(Method::kEnrollmentsEnumerated, ids.size());
+    }
+    ndk::ScopedAStatus onEnrollmentsRemoved(const std::vector<int32_t>& ids) override {
+        return record(Method::kEnrollmentsRemoved, ids.size());
+    }
+    ndk::ScopedAStatus onAuthenticatorIdRetrieved(int64_t id) override {
+        return record(Method::kAuthenticatorIdRetrieved, id);
+    }
+    ndk::ScopedAStatus onAuthenticatorIdInvalidated(int64_t id) override {
+        return record(Method::kAuthenticatorIdInvalidated, id);
+    }
+    ndk::ScopedAStatus onSessionClosed() override { return record(Method::kSessionClosed, 0); }
+
+  private:
+    static constexpr size_t kMethods = static_cast<size_t>(Method::kCount);
+
+    static size_t index(Method method) { return static_cast<size_t>(method); }
+
+    ndk::ScopedAStatus record(Method method, int64_t value) {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mCounts[index(method)]++;
+            mLast[index(method)] = value;
+        }
+        mCond.notify_all();
+        return ndk::ScopedAStatus::ok();
+    }
+
+    mutable std::mutex mLock;
+    std::condition_variable mCond;
+    std::array<uint64_t, kMethods> mCounts{};
+    std::array<int64_t, kMethods> mLast{};
+};
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
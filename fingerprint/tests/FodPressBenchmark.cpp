@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Press to capture latency of the fod_press_status path: from the driver reporting a press on
+// the node to the finger down starting on the worker, where the HAL turns local HBM on and the
+// vendor captures.
+//
+// The node is faked. A regular file never raises POLLPRI, so the benchmark takes a node with the
+// same poll semantics as a sysfs attribute: /proc/sys/kernel/domainname notifies pollers with
+// POLLPRI | POLLERR on every write and reads back what was written. It is written in a UTS
+// namespace of the benchmark's own, the host's domain name is left alone.
+
+#include <benchmark/benchmark.h>
+
+#include <android-base/unique_fd.h>
+
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+#include "FodPressWatcher.h"
+#include "WorkScheduler.h"
+#include "util/Util.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+namespace {
+
+constexpr char kNodePath[] = "/proc/sys/kernel/domainname";
+constexpr int32_t kPressPointer = 1;
+
+// What the engine does on a press: the finger down goes to the worker as a pointer down.
+class PressRig {
+  public:
+    PressRig()
+        : mWorker(5),
+          mWatcher([this](bool pressed, int64_t timeNs) { onPress(pressed, timeNs); }) {}
+
+    // Whatever thread calls this has to do all the writes, the namespace is per thread.
+    bool start() {
+        if (unshare(CLONE_NEWUTS) != 0) return false;
+        mNode.reset(TEMP_FAILURE_RETRY(open(kNodePath, O_WRONLY | O_CLOEXEC)));
+        return mNode.ok() && write(false) && mWatcher.start(kNodePath);
+    }
+
+    bool write(bool pressed) {
+        return TEMP_FAILURE_RETRY(pwrite(mNode.get(), pressed ? "1" : "0", 1, 0)) == 1;
+    }
+
+    // Presses, waits for the finger down to reach the worker and releases. Gives the times from
+    // the write to the handler and to the worker, false if the press got lost.
+    bool press(int64_t* toHandlerNs, int64_t* toWorkerNs) {
+        std::unique_lock<std::mutex> lock(mLock);
+        mPressNs = mWorkerNs = 0;
+        mReleased = false;
+        int64_t start = Util::getSystemNanoTime();
+        if (!write(true)) return false;
+        if (!mCond.wait_for(lock, std::chrono::seconds(1), [this] { return mWorkerNs != 0; })) {
+            return false;
+        }
+        *toHandlerNs = mPressNs - start;
+        *toWorkerNs = mWorkerNs - start;
+
+        // Released outside the measurement, so the next press changes the value again.
+        if (!write(false)) return false;
+        return mCond.wait_for(lock, std::chrono::seconds(1), [this] { return mReleased; });
+    }
+
+  private:
+    void onPress(bool pressed, int64_t timeNs) {
+        if (!pressed) {
+            std::lock_guard<std::mutex> lock(mLock);
+            mReleased = true;
+            mCond.notify_one();
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mPressNs = timeNs;
+        }
+        mWorker.schedule(WorkScheduler::TaskKind::kPointerDown, Callable::from([this] {
+            std::lock_guard<std::mutex> lock(mLock);
+            mWorkerNs = Util::getSystemNanoTime();
+            mCond.notify_one();
+        }), kPressPointer);
+    }
+
+    WorkScheduler mWorker;
+    ::android::base::unique_fd mNode;
+    std::mutex mLock;
+    std::condition_variable mCond;
+    int64_t mPressNs = 0;
+    int64_t mWorkerNs = 0;
+    bool mReleased = false;
+    // Declared last, its thread calls into the members above.
+    FodPressWatcher mWatcher;
+};
+
+void BM_PressToWorker(benchmark::State& state) {
+    PressRig rig;
+    if (!rig.start()) {
+        state.SkipWithError("can't fake the node, needs root");
+        return;
+    }
+    int64_t toHandlerNs = 0;
+    int64_t totalToHandlerNs = 0;
+    int64_t toWorkerNs = 0;
+    for (auto _ : state) {
+        if (!rig.press(&toHandlerNs, &toWorkerNs)) {
+            state.SkipWithError("press not delivered");
+            return;
+        }
+        totalToHandlerNs += toHandlerNs;
+        state.SetIterationTime(toWorkerNs / 1e9);
+    }
+    state.counters["toHandlerUs"] =
+            benchmark::Counter(totalToHandlerNs / 1e3, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_PressToWorker)->UseManualTime();
+
+}  // namespace
+}  // namespace aidl::android::hardware::biometrics::fingerprint
+
+BENCHMARK_MAIN();
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "FodStateMachine.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+namespace {
+
+using M = FodStateMachine;
+
+// Records every call, and which outputs it touched, instead of writing to the hardware.
+class FakeActuator : public FodActuator {
+  public:
+    void setFodStatus(bool on) override { record(M::kFodStatus, on ? "fod 1" : "fod 0"); }
+    void setPressCoordinates(int32_t x, int32_t y) override {
+        record(M::kCoordinates, "coords " + std::to_string(x) + "," + std::to_string(y));
+    }
+    void setPressStatus(bool pressed) override {
+        record(M::kPressStatus, pressed ? "press 1" : "press 0");
+    }
+    void setLocalHbm(bool on) override { record(M::kLocalHbm, on ? "hbm 1" : "hbm 0"); }
+    void cancelLocalHbm() override { calls.push_back("cancel hbm"); }
+
+    void clear() {
+        calls.clear();
+        written = 0;
+    }
+
+    std::vector<std::string> calls;
+    uint8_t written = 0;
+
+  private:
+    void record(uint8_t output, std::string call) {
+        written |= output;
+        calls.push_back(std::move(call));
+    }
+};
+
+// Shortest event sequence from idle to each state.
+std::vector<FodEvent> pathTo(FodState state) {
+    switch (state) {
+        case FodState::kArmed:
+            return {FodEvent::kWaitingForFinger};
+        case FodState::kIlluminated:
+            return {FodEvent::kFingerDown};
+        case FodState::kCapturing:
+            return {FodEvent::kFingerDown, FodEvent::kAcquired};
+        case FodState::kDone:
+            return {FodEvent::kFingerDown, FodEvent::kAcquiredGood};
+        default:
+            return {};
+    }
+}
+
+class FodStateMachineTest : public ::testing::Test {
+  protected:
+    void driveTo(FodState state) {
+        for (FodEvent event : pathTo(state)) mMachine.dispatch(event, 10, 20);
+        ASSERT_EQ(mMachine.state(), state);
+        mActuator.clear();
+    }
+
+    FakeActuator mActuator;
+    FodStateMachine mMachine{&mActuator};
+};
+
+TEST_F(FodStateMachineTest, Unlock) {
+    EXPECT_EQ(mMachine.dispatch(FodEvent::kWaitingForFinger), FodState::kArmed);
+    EXPECT_EQ(mActuator.calls, std::vector<std::string>({"fod 1"}));
+
+    mActuator.clear();
+    EXPECT_EQ(mMachine.dispatch(FodEvent::kFingerDown, 10, 20), FodState::kIlluminated);
+    // The panel ramp starts before the coordinates, the press waits for it.
+    EXPECT_EQ(mActuator.calls, std::vector<std::string>({"hbm 1", "coords 10,20", "press 1"}));
+
+    mActuator.clear();
+    EXPECT_EQ(mMachine.dispatch(FodEvent::kAcquiredGood), FodState::kDone);
+    EXPECT_EQ(mActuator.calls, std::vector<std::string>(
+                                       {"coords 0,0", "press 0", "cancel hbm", "hbm 0", "fod 0"}));
+
+    mActuator.clear();
+    EXPECT_EQ(mMachine.dispatch(FodEvent::kFingerUp), FodState::kIdle);
+    EXPECT_TRUE(mActuator.calls.empty());
+}
+
+TEST_F(FodStateMachineTest, RepeatedEventsDoNoIo) {
+    mMachine.dispatch(FodEvent::kWaitingForFinger);
+    mActuator.clear();
+    EXPECT_EQ(mMachine.dispatch(FodEvent::kWaitingForFinger), FodState::kArmed);
+    EXPECT_TRUE(mActuator.calls.empty());
+
+    mMachine.dispatch(FodEvent::kFingerDown, 10, 20);
+    mActuator.clear();
+    EXPECT_EQ(mMachine.dispatch(FodEvent::kFingerDown, 10, 20), FodState::kIlluminated);
+    EXPECT_TRUE(mActuator.calls.empty());
+}
+
+TEST_F(FodStateMachineTest, ScanFailedRearmsAndRetries) {
+    driveTo(FodState::kIlluminated);
+    EXPECT_EQ(mMachine.dispatch(FodEvent::kScanFailed), FodState::kArmed);
+    // fod_press_status stays on, the vendor still waits for the finger.
+    EXPECT_EQ(mActuator.calls,
+              std::vector<std::string>({"coords 0,0", "press 0", "cancel hbm", "hbm 0"}));
+
+    mActuator.clear();
+    EXPECT_EQ(mMachine.dispatch(FodEvent::kFingerDown, 30, 40), FodState::kIlluminated);
+    EXPECT_EQ(mActuator.calls, std::vector<std::string>({"hbm 1", "coords 30,40", "press 1"}));
+}
+
+TEST_F(FodStateMachineTest, FingerUpWhileCapturingRearms) {
+    driveTo(FodState::kCapturing);
+    EXPECT_EQ(mMachine.dispatch(FodEvent::kFingerUp), FodState::kArmed);
+    EXPECT_TRUE(mActuator.calls.empty());
+}
+
+TEST(FodStateMachineTableTest, EveryTransitionWritesExactlyTheChangedOutputs) {
+    for (size_t s = 0; s < M::kStates; s++) {
+        for (size_t e = 0; e < M::kEvents; e++) {
+            FakeActuator actuator;
+            FodStateMachine machine(&actuator);
+            FodState from = static_cast<FodState>(s);
+            FodEvent event = static_cast<FodEvent>(e);
+            for (FodEvent step : pathTo(from)) machine.dispatch(step, 10, 20);
+            ASSERT_EQ(machine.state(), from);
+            actuator.clear();
+
+            FodState to = machine.dispatch(event, 10, 20);
+            EXPECT_EQ(to, M::next(from, event)) << "state " << s << " event " << e;
+            EXPECT_EQ(actuator.written, M::actions(from, to)) << "state " << s << " event " << e;
+        }
+    }
+}
+
+TEST(FodStateMachineTableTest, ResetTurnsEverythingOff) {
+    for (size_t s = 0; s < M::kStates; s++) {
+        FakeActuator actuator;
+        FodStateMachine machine(&actuator);
+        FodState from = static_cast<FodState>(s);
+        for (FodEvent step : pathTo(from)) machine.dispatch(step, 10, 20);
+        actuator.clear();
+
+        EXPECT_EQ(machine.dispatch(FodEvent::kReset), FodState::kIdle);
+        EXPECT_EQ(actuator.written, M::kStateOutputs[s]) << "state " << s;
+        for (const std::string& call : actuator.calls) {
+            EXPECT_TRUE(call == "cancel hbm" || call == "coords 0,0" || call.back() == '0')
+                    << "state " << s << ": " << call;
+        }
+    }
+}
+
+}  // namespace
+}  // namespace aidl::android::hardware::biometrics::fingerprint
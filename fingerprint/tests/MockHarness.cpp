@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "MockHarness.h"
+
+#include <android-base/properties.h>
+#include <android/binder_auto_utils.h>
+
+#include <vector>
+
+#include "MockModule.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+using namespace std::chrono_literals;
+
+std::shared_ptr<Fingerprint>* MockHarness::sHal = nullptr;
+int32_t MockHarness::sSensorId = 0;
+
+void MockHarness::SetUpTestSuite() {
+    ::android::base::SetProperty("vendor.fps_hal.mock.latency_ms", "5");
+    // Lives as long as the process, like in the service.
+    sHal = new std::shared_ptr<Fingerprint>(ndk::SharedRefBase::make<Fingerprint>());
+    std::vector<SensorProps> props;
+    ASSERT_TRUE((*sHal)->getSensorProps(&props).isOk());
+    ASSERT_FALSE(props.empty());
+    sSensorId = props[0].commonProps.sensorId;
+}
+
+void MockHarness::SetUp() {
+    ASSERT_NE(mockDevice(), nullptr);
+    mCb = ndk::SharedRefBase::make<FakeSessionCallback>();
+    ASSERT_TRUE((*sHal)->createSession(sSensorId, kUserId, mCb, &mSession).isOk());
+}
+
+void MockHarness::TearDown() {
+    if (mSession == nullptr) return;
+    uint64_t closed = mCb->count(Method::kSessionClosed);
+    mSession->close();
+    EXPECT_TRUE(mCb->waitFor(Method::kSessionClosed, closed + 1));
+}
+
+fingerprint_device_t* MockHarness::mockDevice() {
+    return openedMockDevice();
+}
+
+bool MockHarness::pressUntil(Method method, uint64_t count) {
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (std::chrono::steady_clock::now() < deadline) {
+        fingerprint_device_t* device = mockDevice();
+        device->goodixExtCmd(device, COMMAND_FOD_PRESS_STATUS, PARAM_FOD_PRESSED);
+        if (mCb->waitFor(method, count, kPressWindow)) return true;
+    }
+    return false;
+}
+
+int64_t MockHarness::enroll() {
+    keymaster::HardwareAuthToken hat;
+    hat.mac.resize(sizeof(hw_auth_token_t::hmac));
+    std::shared_ptr<common::ICancellationSignal> cancel;
+    EXPECT_TRUE(mSession->enroll(hat, &cancel).isOk());
+    uint64_t steps = mCb->count(Method::kEnrollmentProgress);
+    do {
+        if (!pressUntil(Method::kEnrollmentProgress, ++steps)) return 0;
+    } while (mCb->last(Method::kEnrollmentProgress) > 0);
+
+    uint64_t enumerated = mCb->count(Method::kEnrollmentsEnumerated);
+    mSession->enumerateEnrollments();
+    EXPECT_TRUE(mCb->waitFor(Method::kEnrollmentsEnumerated, enumerated + 1));
+    return mCb->last(Method::kEnrollmentsEnumerated);
+}
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
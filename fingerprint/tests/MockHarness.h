@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#include "FakeSessionCallback.h"
+#include "Fingerprint.h"
+#include "fingerprint-xiaomi.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+// Runs the whole service, from ISession down to the vendor ABI, against the scripted mock
+// module instead of the sensor, see MockModule.h.
+class MockHarness : public ::testing::Test {
+  protected:
+    using Method = FakeSessionCallback::Method;
+
+    // Not a real user, so the snapshot and the template paths of real users are left alone.
+    static constexpr int32_t kUserId = 9999;
+    // How long one press may take to produce its result before it is repeated: the mock
+    // ignores presses until the vendor call of the operation reached it.
+    static constexpr std::chrono::milliseconds kPressWindow{500};
+
+    static void SetUpTestSuite();
+    void SetUp() override;
+    void TearDown() override;
+
+    // The device the engine opened from the mock, null unless exactly one is open.
+    static fingerprint_device_t* mockDevice();
+
+    // Presses the finger until method was called count times, as the UDFPS engine does with
+    // the press status on a finger down.
+    bool pressUntil(Method method, uint64_t count);
+    // Enrolls a finger, returns how many the user has now.
+    int64_t enroll();
+
+    static std::shared_ptr<Fingerprint>* sHal;
+    static int32_t sSensorId;
+
+    std::shared_ptr<FakeSessionCallback> mCb;
+    std::shared_ptr<ISession> mSession;
+};
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Reports the throughput and latency of authenticate against the mock module, and checks the
+// operations that batch their callbacks.
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "MockHarness.h"
+#include "util/Util.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+namespace {
+
+constexpr int kAuthenticateRounds = 50;
+
+int64_t percentile(std::vector<int64_t> samples, int percent) {
+    std::sort(samples.begin(), samples.end());
+    return samples[(samples.size() - 1) * percent / 100];
+}
+
+class MockHarnessTest : public MockHarness {};
+
+TEST_F(MockHarnessTest, AuthenticateThroughput) {
+    ASSERT_GT(enroll(), 0);
+
+    std::vector<int64_t> latencies;
+    int64_t start = Util::getSystemNanoTime();
+    for (int i = 1; i <= kAuthenticateRounds; i++) {
+        int64_t begin = Util::getSystemNanoTime();
+        std::shared_ptr<common::ICancellationSignal> cancel;
+        ASSERT_TRUE(mSession->authenticate(0, &cancel).isOk());
+        ASSERT_TRUE(pressUntil(Method::kAuthenticationSucceeded, i)) << "round " << i;
+        latencies.push_back(Util::getSystemNanoTime() - begin);
+    }
+    int64_t elapsedNs = Util::getSystemNanoTime() - start;
+    EXPECT_EQ(mCb->count(Method::kError), 0u);
+    EXPECT_EQ(mCb->count(Method::kAuthenticationFailed), 0u);
+
+    double opsPerSec = kAuthenticateRounds * 1e9 / elapsedNs;
+    int64_t p50 = percentile(latencies, 50), p90 = percentile(latencies, 90),
+            p99 = percentile(latencies, 99);
+    RecordProperty("ops_per_sec", static_cast<int>(opsPerSec));
+    RecordProperty("p50_us", static_cast<int>(p50 / 1000));
+    RecordProperty("p90_us", static_cast<int>(p90 / 1000));
+    RecordProperty("p99_us", static_cast<int>(p99 / 1000));
+    printf("authenticate: %.1f ops/s, p50 %.2fms p90 %.2fms p99 %.2fms\n", opsPerSec,
+           p50 / 1e6, p90 / 1e6, p99 / 1e6);
+
+    // Queue depths, drops and per-callback timings of the run.
+    TemporaryFile dump;
+    ASSERT_EQ((*sHal)->dump(dump.fd, nullptr, 0), STATUS_OK);
+    std::string out;
+    ASSERT_TRUE(::android::base::ReadFileToString(dump.path, &out));
+    printf("%s", out.c_str());
+}
+
+TEST_F(MockHarnessTest, CancelAuthenticate) {
+    std::shared_ptr<common::ICancellationSignal> cancel;
+    ASSERT_TRUE(mSession->authenticate(0, &cancel).isOk());
+    ASSERT_TRUE(cancel->cancel().isOk());
+    ASSERT_TRUE(mCb->waitFor(Method::kError, 1));
+    EXPECT_EQ(mCb->last(Method::kError), static_cast<int64_t>(Error::CANCELED));
+}
+
+TEST_F(MockHarnessTest, RemoveEnrollments) {
+    ASSERT_GT(enroll(), 0);
+
+    // The mock hands out IDs from 1, remove them all in one go.
+    std::vector<int32_t> ids;
+    for (int32_t id = 1; id <= 64; id++) ids.push_back(id);
+    ASSERT_TRUE(mSession->removeEnrollments(ids).isOk());
+    ASSERT_TRUE(mCb->waitFor(Method::kEnrollmentsRemoved, 1));
+    // One callback for the whole list, however many the vendor reported one by one.
+    EXPECT_EQ(mCb->count(Method::kEnrollmentsRemoved), 1u);
+    EXPECT_EQ(mCb->last(Method::kEnrollmentsRemoved), static_cast<int64_t>(ids.size()));
+
+    uint64_t enumerated = mCb->count(Method::kEnrollmentsEnumerated);
+    mSession->enumerateEnrollments();
+    ASSERT_TRUE(mCb->waitFor(Method::kEnrollmentsEnumerated, enumerated + 1));
+    EXPECT_EQ(mCb->last(Method::kEnrollmentsEnumerated), 0);
+}
+
+}  // namespace
+}  // namespace aidl::android::hardware::biometrics::fingerprint
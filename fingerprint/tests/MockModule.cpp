@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "MockModule.h"
+
+#include <mutex>
+#include <set>
+
+extern fingerprint_module_t HAL_MODULE_INFO_SYM;
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+namespace {
+
+// Devices of the mock the engine opened and has not closed yet.
+std::mutex gDevicesLock;
+std::set<fingerprint_device_t*> gDevices;
+int (*gMockClose)(hw_device_t*) = nullptr;
+
+int closeMock(hw_device_t* device) {
+    {
+        std::lock_guard<std::mutex> lock(gDevicesLock);
+        gDevices.erase(reinterpret_cast<fingerprint_device_t*>(device));
+    }
+    return gMockClose(device);
+}
+
+int openMock(const hw_module_t* module, const char* id, hw_device_t** device) {
+    int error = HAL_MODULE_INFO_SYM.common.methods->open(module, id, device);
+    if (error != 0) return error;
+    std::lock_guard<std::mutex> lock(gDevicesLock);
+    gMockClose = (*device)->close;
+    (*device)->close = closeMock;
+    gDevices.insert(reinterpret_cast<fingerprint_device_t*>(*device));
+    return 0;
+}
+
+}  // namespace
+
+hw_module_methods_t gMockMethods = {.open = openMock};
+
+fingerprint_device_t* openedMockDevice() {
+    std::lock_guard<std::mutex> lock(gDevicesLock);
+    return gDevices.size() == 1 ? *gDevices.begin() : nullptr;
+}
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
+
+// Stands in for the libhardware lookup: whichever module the engine probes is the mock.
+extern "C" int hw_get_module_by_class(const char* /*class_id*/, const char* /*inst*/,
+                                      const struct hw_module_t** module) {
+    static const hw_module_t sModule = [] {
+        hw_module_t module = HAL_MODULE_INFO_SYM.common;
+        module.methods = &aidl::android::hardware::biometrics::fingerprint::gMockMethods;
+        return module;
+    }();
+    *module = &sModule;
+    return 0;
+}
@@ -0,0 +1,19 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "fingerprint-xiaomi.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+// Linking MockModule.cpp makes every module lookup of the engine return the scripted mock
+// module instead of the sensor.
+
+// The device the engine opened from the mock, null unless exactly one is open.
+fingerprint_device_t* openedMockDevice();
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Cost of dispatching pointer events into the engine. Built twice: against the library fixed
+// to the sensor_type of the product, where Engine is final and the calls are direct, and against
+// the generic library, where they go through the vtable. Compare the two binaries' output.
+//
+// Only paths that do no I/O are measured: a finger down on the sensor turns local HBM on. The
+// engines open the mock module, MockModule.cpp is linked in.
+
+#include <benchmark/benchmark.h>
+
+#include <android/binder_auto_utils.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "FakeSessionCallback.h"
+#include "Fingerprint.h"
+#include "FingerprintEngineSelect.h"
+#include "util/Util.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+namespace {
+
+// Not a real user, so the snapshot and the template paths of real users are left alone.
+constexpr int32_t kUserId = 9999;
+constexpr int32_t kPointerId = 1;
+// Pointer ups dispatched per task posted to the worker.
+constexpr int kBatch = 1000;
+
+// The engines below need a service to take their notify callback from. Both live as long as
+// the process, like in the service.
+Fingerprint* hal() {
+    static std::shared_ptr<Fingerprint>* sHal =
+            new std::shared_ptr<Fingerprint>(ndk::SharedRefBase::make<Fingerprint>());
+    return sHal->get();
+}
+
+struct EngineRig {
+    WorkScheduler worker{5};
+    TimerService timers;
+    Engine* engine;
+};
+
+// An engine held the way the service holds it. Made here, the compiler would know its dynamic
+// type and call it directly in the generic build too, so the pointer is laundered.
+EngineRig* rig() {
+    static EngineRig* sRig = [] {
+        hal();
+        auto* rig = new EngineRig();
+        rig->engine = new Engine();
+        benchmark::DoNotOptimize(rig->engine);
+        rig->engine->attach(&rig->worker, &rig->timers);
+        return rig;
+    }();
+    return sRig;
+}
+
+// A touch away from the sensor and its release, as the binder thread handles them: hit-tested
+// and rejected by the engine.
+void BM_RejectedPointer(benchmark::State& state) {
+    auto cb = ndk::SharedRefBase::make<FakeSessionCallback>();
+    std::vector<SensorProps> props;
+    hal()->getSensorProps(&props);
+    std::shared_ptr<ISession> session;
+    if (props.empty() ||
+        !hal()->createSession(props[0].commonProps.sensorId, kUserId, cb, &session).isOk()) {
+        state.SkipWithError("createSession failed");
+        return;
+    }
+    for (auto _ : state) {
+        session->onPointerDown(kPointerId, 0, 0, 0.0f, 0.0f);
+        session->onPointerUp(kPointerId);
+    }
+    state.SetItemsProcessed(state.iterations());
+    session->close();
+    cb->waitFor(FakeSessionCallback::Method::kSessionClosed, 1);
+}
+BENCHMARK(BM_RejectedPointer);
+
+// Pointer ups on the worker thread, where the scheduler runs them. With no finger down the FOD
+// state machine stays idle and writes nothing.
+void BM_PointerUpOnWorker(benchmark::State& state) {
+    EngineRig* r = rig();
+    std::mutex lock;
+    std::condition_variable cond;
+    for (auto _ : state) {
+        int64_t elapsedNs = -1;
+        r->worker.schedule(WorkScheduler::TaskKind::kPointerUp, Callable::from([&] {
+            int64_t start = Util::getSystemNanoTime();
+            for (int i = 0; i < kBatch; i++) r->engine->onPointerUpImpl(kPointerId);
+            std::lock_guard<std::mutex> guard(lock);
+            elapsedNs = Util::getSystemNanoTime() - start;
+            cond.notify_one();
+        }), kPointerId);
+        std::unique_lock<std::mutex> guard(lock);
+        cond.wait(guard, [&] { return elapsedNs >= 0; });
+        state.SetIterationTime(elapsedNs / 1e9);
+    }
+    state.SetItemsProcessed(state.iterations() * kBatch);
+}
+BENCHMARK(BM_PointerUpOnWorker)->UseManualTime();
+
+}  // namespace
+}  // namespace aidl::android::hardware::biometrics::fingerprint
+
+BENCHMARK_MAIN();
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Start-up of the service on the mock module, split like the service splits it. Phase one, the
+// constructor, only needs /vendor: after it the service registers, this is "HAL ready". Phase
+// two loads the state in /data and the first setActiveGroup() makes an unlock possible.
+//
+// /data is mounted when this runs, so both phases run back to back, as they did when the
+// service started in late_start: firstUnlockMs is the time from the service starting to the
+// first possible unlock then. Started in class hal, the service is ready halReadyMs after it
+// starts, well before /data, and the first unlock comes dataPhaseMs after /data is mounted. The
+// boot-relative points of a real boot are in the dump, "boot: halReady= dataReady=
+// firstActiveGroup=".
+
+#include <benchmark/benchmark.h>
+
+#include <android/binder_auto_utils.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "FakeSessionCallback.h"
+#include "Fingerprint.h"
+#include "util/Util.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+namespace {
+
+using Method = FakeSessionCallback::Method;
+
+// Not a real user, so the snapshot and the template paths of real users are left alone.
+constexpr int32_t kUserId = 9999;
+// Every start opens another device from the mock and keeps it.
+constexpr int kStarts = 10;
+
+void BM_Startup(benchmark::State& state) {
+    // Never destroyed: the vendor threads of the devices they opened may still call back.
+    static auto* sHals = new std::vector<std::shared_ptr<Fingerprint>>();
+    int64_t totalReadyNs = 0;
+    int64_t totalUnlockNs = 0;
+    for (auto _ : state) {
+        int64_t start = Util::getSystemNanoTime();
+        auto hal = ndk::SharedRefBase::make<Fingerprint>();
+        int64_t readyNs = Util::getSystemNanoTime() - start;
+        sHals->push_back(hal);
+
+        std::vector<SensorProps> props;
+        hal->getSensorProps(&props);
+        auto cb = ndk::SharedRefBase::make<FakeSessionCallback>();
+        std::shared_ptr<ISession> session;
+        if (props.empty() ||
+            !hal->createSession(props[0].commonProps.sensorId, kUserId, cb, &session).isOk()) {
+            state.SkipWithError("createSession failed");
+            return;
+        }
+        // Queued behind the session's setActiveGroup() on the worker.
+        session->enumerateEnrollments();
+        if (!cb->waitFor(Method::kEnrollmentsEnumerated, 1)) {
+            state.SkipWithError("setActiveGroup did not finish, is vendor.fps_hal.data_ready set?");
+            return;
+        }
+        int64_t unlockNs = Util::getSystemNanoTime() - start;
+
+        session->close();
+        cb->waitFor(Method::kSessionClosed, 1);
+        totalReadyNs += readyNs;
+        totalUnlockNs += unlockNs;
+        state.SetIterationTime(unlockNs / 1e9);
+    }
+    state.counters["halReadyMs"] =
+            benchmark::Counter(totalReadyNs / 1e6, benchmark::Counter::kAvgIterations);
+    state.counters["firstUnlockMs"] =
+            benchmark::Counter(totalUnlockNs / 1e6, benchmark::Counter::kAvgIterations);
+    state.counters["dataPhaseMs"] = benchmark::Counter((totalUnlockNs - totalReadyNs) / 1e6,
+                                                       benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_Startup)->UseManualTime()->Iterations(kStarts);
+
+}  // namespace
+}  // namespace aidl::android::hardware::biometrics::fingerprint
+
+BENCHMARK_MAIN();
@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2025 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <android-base/unique_fd.h>
+#include <gtest/gtest.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <linux/uinput.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "TouchInputReader.h"
+#include "util/Util.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+namespace {
+
+using namespace std::chrono_literals;
+
+constexpr int32_t kMaxX = 1079;
+constexpr int32_t kMaxY = 2399;
+
+// A multi-touch panel made up with uinput, standing in for the goodix touch node.
+class UinputTouchscreen {
+  public:
+    bool create() {
+        mFd.reset(TEMP_FAILURE_RETRY(open("/dev/uinput", O_WRONLY | O_NONBLOCK | O_CLOEXEC)));
+        if (!mFd.ok()) return false;
+
+        ioctl(mFd.get(), UI_SET_EVBIT, EV_SYN);
+        ioctl(mFd.get(), UI_SET_EVBIT, EV_ABS);
+        ioctl(mFd.get(), UI_SET_PROPBIT, INPUT_PROP_DIRECT);
+        setupAbs(ABS_MT_SLOT, 0, 9);
+        setupAbs(ABS_MT_TRACKING_ID, 0, 65535);
+        setupAbs(ABS_MT_POSITION_X, 0, kMaxX);
+        setupAbs(ABS_MT_POSITION_Y, 0, kMaxY);
+
+        uinput_setup setup = {};
+        setup.id.bustype = BUS_VIRTUAL;
+        snprintf(setup.name, sizeof(setup.name), "fingerprint-test-touch");
+        if (ioctl(mFd.get(), UI_DEV_SETUP, &setup) != 0 ||
+            ioctl(mFd.get(), UI_DEV_CREATE) != 0) {
+            return false;
+        }
+        mPath = findEventNode();
+        return !mPath.empty();
+    }
+
+    ~UinputTouchscreen() {
+        if (mFd.ok()) ioctl(mFd.get(), UI_DEV_DESTROY);
+    }
+
+    const std::string& path() const { return mPath; }
+
+    void down(int32_t slot, int32_t trackingId, int32_t x, int32_t y) {
+        emit(EV_ABS, ABS_MT_SLOT, slot);
+        emit(EV_ABS, ABS_MT_TRACKING_ID, trackingId);
+        emit(EV_ABS, ABS_MT_POSITION_X, x);
+        emit(EV_ABS, ABS_MT_POSITION_Y, y);
+    }
+
+    void move(int32_t slot, int32_t x, int32_t y) {
+        emit(EV_ABS, ABS_MT_SLOT, slot);
+        emit(EV_ABS, ABS_MT_POSITION_X, x);
+        emit(EV_ABS, ABS_MT_POSITION_Y, y);
+    }
+
+    void up(int32_t slot) {
+        emit(EV_ABS, ABS_MT_SLOT, slot);
+        emit(EV_ABS, ABS_MT_TRACKING_ID, -1);
+    }
+
+    void report() { emit(EV_SYN, SYN_REPORT, 0); }
+
+  private:
+    void setupAbs(uint16_t code, int32_t min, int32_t max) {
+        ioctl(mFd.get(), UI_SET_ABSBIT, code);
+        uinput_abs_setup abs = {};
+        abs.code = code;
+        abs.absinfo.minimum = min;
+        abs.absinfo.maximum = max;
+        ioctl(mFd.get(), UI_ABS_SETUP, &abs);
+    }
+
+    void emit(uint16_t type, uint16_t code, int32_t value) {
+        input_event event = {};
+        event.type = type;
+        event.code = code;
+        event.value = value;
+        ASSERT_EQ(write(mFd.get(), &event, sizeof(event)), static_cast<ssize_t>(sizeof(event)));
+    }
+
+    // The evdev node the kernel created for the device, /dev/input/eventN.
+    std::string findEventNode() {
+        char sysname[64] = {};
+        if (ioctl(mFd.get(), UI_GET_SYSNAME(sizeof(sysname)), sysname) < 0) return "";
+        std::string dir = std::string("/sys/devices/virtual/input/") + sysname;
+        // udev or ueventd may take a moment to create the node.
+        for (int attempt = 0; attempt < 100; attempt++) {
+            if (DIR* entries = opendir(dir.c_str())) {
+                std::string node;
+                while (dirent* entry = readdir(entries)) {
+                    if (strncmp(entry->d_name, "event", 5) == 0) node = entry->d_name;
+                }
+                closedir(entries);
+                std::string path = "/dev/input/" + node;
+                if (!node.empty() && access(path.c_str(), R_OK) == 0) return path;
+            }
+            std::this_thread::sleep_for(10ms);
+        }
+        return "";
+    }
+
+    ::android::base::unique_fd mFd;
+    std::string mPath;
+};
+
+struct Touch {
+    bool down;
+    int32_t slot;
+    int32_t x;
+    int32_t y;
+    int64_t timeNs;
+    // When the handler ran.
+    int64_t reportedNs;
+};
+
+class TouchInputReaderTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        if (!mPanel.create()) GTEST_SKIP() << "uinput not available";
+        ASSERT_TRUE(mReader.start(mPanel.path()));
+    }
+
+    bool waitForTouches(size_t count) {
+        std::unique_lock<std::mutex> lock(mLock);
+        return mCond.wait_for(lock, 2s, [&] { return mTouches.size() >= count; });
+    }
+
+    std::vector<Touch> touches() {
+        std::lock_guard<std::mutex> lock(mLock);
+        return mTouches;
+    }
+
+    void record(Touch touch) {
+        touch.reportedNs = Util::getSystemNanoTime();
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mTouches.push_back(touch);
+        }
+        mCond.notify_all();
+    }
+
+    UinputTouchscreen mPanel;
+    std::mutex mLock;
+    std::condition_variable mCond;
+    std::vector<Touch> mTouches;
+    // Declared last, its thread calls into the members above.
+    TouchInputReader mReader{
+            [this](int32_t slot, int32_t x, int32_t y, int64_t timeNs) {
+                record({true, slot, x, y, timeNs, 0});
+            },
+            [this](int32_t slot, int64_t timeNs) { record({false, slot, -1, -1, timeNs, 0}); }};
+};
+
+TEST_F(TouchInputReaderTest, DownAndUp) {
+    int64_t before = Util::getSystemNanoTime();
+    mPanel.down(0, 1, 540, 1900);
+    mPanel.report();
+    ASSERT_TRUE(waitForTouches(1));
+    mPanel.up(0);
+    mPanel.report();
+    ASSERT_TRUE(waitForTouches(2));
+
+    auto touches = this->touches();
+    ASSERT_EQ(touches.size(), 2u);
+    EXPECT_TRUE(touches[0].down);
+    EXPECT_EQ(touches[0].slot, 0);
+    EXPECT_EQ(touches[0].x, 540);
+    EXPECT_EQ(touches[0].y, 1900);
+    // Kernel event time on the clock of Util::getSystemNanoTime().
+    EXPECT_GE(touches[0].timeNs, before);
+    EXPECT_LE(touches[0].timeNs, touches[0].reportedNs);
+    EXPECT_FALSE(touches[1].down);
+    EXPECT_EQ(touches[1].slot, 0);
+    printf("event to handler: %.3fms\n", (touches[0].reportedNs - touches[0].timeNs) / 1e6);
+}
+
+TEST_F(TouchInputReaderTest, MovesDoNotReportAgain) {
+    mPanel.down(0, 1, 540, 1900);
+    mPanel.report();
+    ASSERT_TRUE(waitForTouches(1));
+    mPanel.move(0, 545, 1905);
+    mPanel.report();
+    mPanel.move(0, 550, 1910);
+    mPanel.report();
+    mPanel.up(0);
+    mPanel.report();
+    ASSERT_TRUE(waitForTouches(2));
+
+    auto touches = this->touches();
+    ASSERT_EQ(touches.size(), 2u);
+    EXPECT_TRUE(touches[0].down);
+    EXPECT_FALSE(touches[1].down);
+}
+
+TEST_F(TouchInputReaderTest, ContactsInSeparateSlots) {
+    mPanel.down(0, 1, 100, 200);
+    mPanel.report();
+    mPanel.down(1, 2, 540, 1900);
+    mPanel.report();
+    mPanel.up(0);
+    mPanel.report();
+    mPanel.up(1);
+    mPanel.report();
+    ASSERT_TRUE(waitForTouches(4));
+
+    auto touches = this->touches();
+    ASSERT_EQ(touches.size(), 4u);
+    EXPECT_TRUE(touches[0].down);
+    EXPECT_EQ(touches[0].slot, 0);
+    EXPECT_EQ(touches[0].x, 100);
+    EXPECT_TRUE(touches[1].down);
+    EXPECT_EQ(touches[1].slot, 1);
+    EXPECT_EQ(touches[1].y, 1900);
+    EXPECT_FALSE(touches[2].down);
+    EXPECT_EQ(touches[2].slot, 0);
+    EXPECT_FALSE(touches[3].down);
+    EXPECT_EQ(touches[3].slot, 1);
+}
+
+TEST_F(TouchInputReaderTest, NothingBeforeTheReport) {
+    mPanel.down(0, 1, 540, 1900);
+    std::this_thread::sleep_for(50ms);
+    EXPECT_TRUE(touches().empty());
+    mPanel.report();
+    EXPECT_TRUE(waitForTouches(1));
+}
+
+}  // namespace
+}  // namespace aidl::android::hardware::biometrics::fingerprint